@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#include "stdafx.h"
+#include "OspreyCameraPath.h"
+
+namespace Osprey
+{
+    namespace
+    {
+        void setCamera(ON_3dmView& view, const ON_3dPoint& location, const ON_3dPoint& target, const ON_3dVector& up)
+        {
+            ON_3dVector direction = target - location;
+            direction.Unitize();
+            ON_3dVector cameraUp = up;
+            cameraUp.Unitize();
+            view.m_vp.SetCameraLocation(location);
+            view.m_vp.SetCameraDirection(direction);
+            view.m_vp.SetCameraUp(cameraUp);
+            view.m_vp.SetTargetPoint(target);
+        }
+
+        double lerp(double a, double b, double t)
+        {
+            return (1.0 - t) * a + t * b;
+        }
+
+        //! Interpolate the lens between two views. The lens length is
+        //! interpolated between perspective views and the frustum between
+        //! parallel views, otherwise the projection switches half way.
+        void setLens(ON_3dmView& view, const ON_3dmView& a, const ON_3dmView& b, double t)
+        {
+            double lensA = 0.0;
+            double lensB = 0.0;
+            if (a.m_vp.IsPerspectiveProjection() &&
+                b.m_vp.IsPerspectiveProjection() &&
+                a.m_vp.GetCamera35mmLensLength(&lensA) &&
+                b.m_vp.GetCamera35mmLensLength(&lensB))
+            {
+                view.m_vp.SetCamera35mmLensLength(lerp(lensA, lensB, t));
+            }
+            else if (a.m_vp.IsParallelProjection() && b.m_vp.IsParallelProjection())
+            {
+                double fa[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+                double fb[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+                a.m_vp.GetFrustum(&fa[0], &fa[1], &fa[2], &fa[3], &fa[4], &fa[5]);
+                b.m_vp.GetFrustum(&fb[0], &fb[1], &fb[2], &fb[3], &fb[4], &fb[5]);
+                view.m_vp.SetFrustum(
+                    lerp(fa[0], fb[0], t),
+                    lerp(fa[1], fb[1], t),
+                    lerp(fa[2], fb[2], t),
+                    lerp(fa[3], fb[3], t),
+                    lerp(fa[4], fb[4], t),
+                    lerp(fa[5], fb[5], t));
+            }
+        }
+
+    } // namespace
+
+    std::vector<ON_3dmView> getOrbitPath(const ON_3dmView& view, size_t frames)
+    {
+        std::vector<ON_3dmView> out;
+        const ON_3dPoint location = view.m_vp.CameraLocation();
+        const ON_3dPoint target = view.m_vp.TargetPoint();
+        const ON_3dVector up = view.m_vp.CameraUp();
+        for (size_t i = 0; i < frames; ++i)
+        {
+            ON_Xform xform;
+            xform.Rotation(ON_2PI * i / static_cast<double>(frames), ON_3dVector::ZAxis, target);
+            ON_3dmView frame = view;
+            setCamera(frame, xform * location, target, xform * up);
+            out.push_back(frame);
+        }
+        return out;
+    }
+
+    std::vector<ON_3dmView> getNamedViewPath(const CRhinoDoc& rhinoDoc, size_t framesPerView)
+    {
+        std::vector<ON_3dmView> out;
+        const auto& namedViews = rhinoDoc.NamedViewTable();
+        const int count = namedViews.Count();
+        for (int i = 0; i < count; ++i)
+        {
+            const ON_3dmView& a = namedViews[i];
+            out.push_back(a);
+            if (i + 1 < count)
+            {
+                const ON_3dmView& b = namedViews[i + 1];
+                for (size_t j = 1; j < framesPerView; ++j)
+                {
+                    const double t = j / static_cast<double>(framesPerView);
+                    ON_3dmView frame = t < .5 ? a : b;
+                    setCamera(
+                        frame,
+                        (1.0 - t) * a.m_vp.CameraLocation() + t * b.m_vp.CameraLocation(),
+                        (1.0 - t) * a.m_vp.TargetPoint() + t * b.m_vp.TargetPoint(),
+                        (1.0 - t) * a.m_vp.CameraUp() + t * b.m_vp.CameraUp());
+                    setLens(frame, a, b, t);
+                    out.push_back(frame);
+                }
+            }
+        }
+        return out;
+    }
+
+} // namespace Osprey
@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#pragma once
+
+namespace Osprey
+{
+    //! Get a camera path that orbits around the target of a view. The camera
+    //! is rotated around the world Z axis through the target.
+    std::vector<ON_3dmView> getOrbitPath(const ON_3dmView&, size_t frames);
+
+    //! Get a camera path through the named views of a document. The camera and
+    //! the lens are interpolated between each pair of views, with the given
+    //! number of frames from one view to the next. When the projections of
+    //! the views differ the projection switches half way.
+    std::vector<ON_3dmView> getNamedViewPath(const CRhinoDoc&, size_t framesPerView);
+
+} // namespace Osprey
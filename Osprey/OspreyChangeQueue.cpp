@@ -13,15 +13,58 @@ namespace Osprey
         // Angular diameter of the sun.
         const float sunAngularDiameter = .53F;
 
-        // Curve radius.
+        // Curve radius, used when the radius of the curve piping mesh can't
+        // be found.
         const float curveRadius = .05F;
 
+        // Linear segments for each span of curves with a degree greater than
+        // one.
+        const int curveSpanSegments = 16;
+
         // Light intensity multiplier.
         const float lightIntensityMul = 3.F;
 
         // Ambient light intensity.
         const float ambientIntensity = .1F;
 
+        // Meshes with this many triangles or less are flattened.
+        const size_t flattenTriangleMax = 256;
+
+        // Size of the grid cells used to group the flattened meshes.
+        const float flattenCellSize = 100.F;
+
+        // Objects edited this many times within the edit window get fast, low
+        // quality BVH builds.
+        const size_t dynamicEditsMin = 3;
+
+        // Edits older than this are forgotten.
+        const std::chrono::seconds editWindow(10);
+
+        // Static groups with this many triangles or more get compact BVHs.
+        const size_t compactTrianglesMin = 1000000;
+
+        // Number of points in each point cloud chunk.
+        const size_t pointChunkSize = 262144;
+
+        // Point radius relative to the average point spacing.
+        const float pointRadiusScale = .5F;
+
+        // Spread the lower ten bits of a value for a Morton code.
+        uint32_t expandBits(uint32_t v)
+        {
+            v = (v * 0x00010001u) & 0xFF0000FFu;
+            v = (v * 0x00000101u) & 0x0F00F00Fu;
+            v = (v * 0x00000011u) & 0xC30C30C3u;
+            v = (v * 0x00000005u) & 0x49249249u;
+            return v;
+        }
+
+        template<typename T>
+        uint32_t crc(uint32_t value, const T& data)
+        {
+            return ON_CRC32(value, sizeof(T), &data);
+        }
+
     } // namespace
 
 	ChangeQueue::ChangeQueue(
@@ -33,10 +76,20 @@ namespace Osprey
         _rhinoDoc(rhinoDoc),
         _update(update),
         _scene(scene)
-	{}
+	{
+        // Copy the existing curves and point clouds, and then watch for
+        // changes.
+        _addObjects();
+        _objectWatcher.reset(new ObjectWatcher(*this));
+        _objectWatcher->Register();
+        _objectWatcher->Enable(TRUE);
+    }
 
     ChangeQueue::~ChangeQueue()
-    {}
+    {
+        _objectWatcher->Enable(FALSE);
+        _objectWatcher->UnRegister();
+    }
 
     void ChangeQueue::setRendererName(const std::string& value, bool supportsMaterials)
     {
@@ -44,33 +97,143 @@ namespace Osprey
             return;
         _rendererName = value;
         _supportsMaterials = supportsMaterials;
+
+        // Only the materials depend on the renderer, so the geometry and
+        // groups are kept and the materials are converted and bound again.
         _materials.clear();
+        for (auto& i : _instances)
+        {
+            _bindMaterial(i.second);
+        }
+        for (auto& i : _batches)
+        {
+            if (i.second.data)
+            {
+                _bindMaterial(*i.second.data);
+            }
+        }
+        if (_groundPlane)
+        {
+            _bindMaterial(*_groundPlane);
+        }
+        _pointCloudsInit = true;
+    }
+
+    bool ChangeQueue::setFlattenMeshes(bool value)
+    {
+        if (value == _flattenMeshes)
+            return false;
+        _flattenMeshes = value;
+
+        _geometry.clear();
+        _smallMeshes.clear();
+        _curves.clear();
         _instances.clear();
-        _groundPlane.reset();
+        _flattened.clear();
+        _flattenedByMesh.clear();
+        _batches.clear();
+        _instancesInit = true;
+        return true;
+    }
+
+    void ChangeQueue::setPointBudget(size_t value)
+    {
+        _pointBudget = value;
+    }
+
+    uint32_t ChangeQueue::getContentHash() const
+    {
+        uint32_t out = 0;
+        for (const auto& i : _contentHashes)
+        {
+            out = ON_CRC32(out, i.first.size() * sizeof(wchar_t), i.first.c_str());
+            out = crc(out, i.second);
+        }
+        return out;
+    }
+
+    void ChangeQueue::setBVHPolicy(BVHPolicy value)
+    {
+        if (value == _bvhPolicy)
+            return;
+        _bvhPolicy = value;
+
+        // Build the groups again with the new flags.
+        for (auto& i : _instances)
+        {
+            _buildGroup(i.second);
+            i.second.instance.commit();
+        }
+        for (auto& i : _batches)
+        {
+            if (i.second.data)
+            {
+                _buildGroup(*i.second.data);
+                i.second.data->instance.commit();
+            }
+        }
+        if (_groundPlane)
+        {
+            _buildGroup(*_groundPlane);
+            _groundPlane->instance.commit();
+        }
+        _instancesInit = true;
     }
 
     void ChangeQueue::Flush(bool bApplyChanges)
     {
         RhRdk::Realtime::ChangeQueue::Flush(bApplyChanges);
 
+        _updateBatches();
+        _updatePointClouds();
+
+        bool worldChanged = false;
+        if (_clippingChanged)
+        {
+            _clippingChanged = false;
+            worldChanged = _updateClipping();
+        }
         if (_instancesInit)
         {
             _instancesInit = false;
 
             std::vector<ospray::cpp::Instance> instances;
+            instances.reserve(_instances.size() + _batches.size() + _pointClouds.size() + 1);
             for (const auto& i : _instances)
             {
-                instances.push_back(i.second);
+                instances.push_back(i.second.instance);
+            }
+            for (const auto& i : _batches)
+            {
+                if (i.second.data)
+                {
+                    instances.push_back(i.second.data->instance);
+                }
+            }
+            for (const auto& i : _pointClouds)
+            {
+                if (i.second->instance.handle())
+                {
+                    instances.push_back(i.second->instance);
+                }
+            }
+            if (_clipping)
+            {
+                instances.push_back(_clipping->instance);
             }
             if (_groundPlane)
             {
-                instances.push_back(*_groundPlane);
+                instances.push_back(_groundPlane->instance);
             }
             if (instances.size())
             {
                 _scene->world.setParam("instance", ospray::cpp::Data(instances));
-                _scene->world.commit();
             }
+            else
+            {
+                _scene->world.removeParam("instance");
+            }
+            worldChanged = true;
         }
 
         if (_lightsInit)
@@ -93,8 +256,37 @@ namespace Osprey
             if (lights.size())
             {
                 _scene->world.setParam("light", ospray::cpp::Data(lights));
-                _scene->world.commit();
             }
+            else
+            {
+                _scene->world.removeParam("light");
+            }
+            worldChanged = true;
+        }
+
+        if (worldChanged)
+        {
+            // The world BVH is built over the instances, so it only needs
+            // fast builds when the instances are being edited.
+            bool dynamicScene = false;
+            switch (_bvhPolicy)
+            {
+            case BVHPolicy::Automatic: dynamicScene = _instanceEdits.count() >= dynamicEditsMin; break;
+            case BVHPolicy::Dynamic: dynamicScene = true; break;
+            default: break;
+            }
+            _scene->world.setParam("dynamicScene", dynamicScene);
+
+            const auto t = std::chrono::steady_clock::now();
+            _scene->world.commit();
+            _buildTime += std::chrono::steady_clock::now() - t;
+
+            std::stringstream ss;
+            ss << "BVH build: " << _buildCount << " groups, " <<
+                std::chrono::duration_cast<std::chrono::milliseconds>(_buildTime).count() << " ms";
+            printDebug(ss.str());
+            _buildTime = std::chrono::steady_clock::duration::zero();
+            _buildCount = 0;
         }
     }
 
@@ -120,46 +312,64 @@ namespace Osprey
 	{
         auto that = const_cast<ChangeQueue*>(this);
         const auto& vp = view.m_vp;
-        ospcommon::math::vec3f cameraPos = fromRhino(vp.CameraLocation());
-        ospcommon::math::vec3f cameraDir = fromRhino(vp.CameraDirection());
-        ospcommon::math::vec3f cameraUp = fromRhino(vp.CameraUp());
-        const float cameraNear = vp.PerspectiveMinNearDist();
-        if (vp.IsPerspectiveProjection())
-        {
-            that->_scene->camera = ospray::cpp::Camera("perspective");
 
-            _scene->camera.setParam("position", cameraPos);
-            _scene->camera.setParam("direction", cameraDir);
-            _scene->camera.setParam("up", cameraUp);
-            _scene->camera.setParam("nearClip", cameraNear);
+        // The clipping planes only apply to their viewports.
+        if (vp.ViewportId() != _viewportId)
+        {
+            that->_viewportId = vp.ViewportId();
+            that->_clippingChanged = true;
+        }
 
+        CameraData camera;
+        camera.position = fromRhino(vp.CameraLocation());
+        camera.direction = fromRhino(vp.CameraDirection());
+        camera.up = fromRhino(vp.CameraUp());
+        camera.nearClip = vp.PerspectiveMinNearDist();
+        if (vp.IsPerspectiveProjection())
+        {
+            camera.type = "perspective";
             double halfDiagonalAngle = 0.0;
             double halfVerticalAngle = 0.0;
             double halfHorizontalAngle = 0.0;
             vp.GetCameraAngle(&halfDiagonalAngle, &halfVerticalAngle, &halfHorizontalAngle);
-            const float cameraFovY = static_cast<float>(halfVerticalAngle * 2.0 / double(ospcommon::math::two_pi) * 360.0);
-            _scene->camera.setParam("fovy", cameraFovY);
-
-            _scene->camera.commit();
+            camera.fovy = static_cast<float>(halfVerticalAngle * 2.0 / double(ospcommon::math::two_pi) * 360.0);
         }
         else if (vp.IsParallelProjection())
         {
-            that->_scene->camera = ospray::cpp::Camera("orthographic");
-
-            _scene->camera.setParam("position", cameraPos);
-            _scene->camera.setParam("direction", cameraDir);
-            _scene->camera.setParam("up", cameraUp);
-            _scene->camera.setParam("nearClip", cameraNear);
-
-            const float height = static_cast<float>(vp.FrustumHeight());
-            _scene->camera.setParam("height", height);
+            camera.type = "orthographic";
+            camera.height = static_cast<float>(vp.FrustumHeight());
+        }
 
-            _scene->camera.commit();
+        // The camera is only created again when the projection changes, and
+        // only committed when the parameters change. This avoids sending new
+        // objects to the device for every view change, which is expensive with
+        // the MPI offload device.
+        if (camera.type.empty())
+        {
+            that->_scene->camera = ospray::cpp::Camera();
         }
-        else
+        else if (camera.type != _camera.type || !_scene->camera.handle())
         {
-            _scene->camera = ospray::cpp::Camera();
+            that->_scene->camera = ospray::cpp::Camera(camera.type);
+            that->_camera.type.clear();
         }
+        if (!camera.type.empty() && !(camera == _camera))
+        {
+            _scene->camera.setParam("position", camera.position);
+            _scene->camera.setParam("direction", camera.direction);
+            _scene->camera.setParam("up", camera.up);
+            _scene->camera.setParam("nearClip", camera.nearClip);
+            if ("perspective" == camera.type)
+            {
+                _scene->camera.setParam("fovy", camera.fovy);
+            }
+            else
+            {
+                _scene->camera.setParam("height", camera.height);
+            }
+            _scene->camera.commit();
+        }
+        that->_camera = camera;
 	}
 
     void ChangeQueue::ApplyDynamicObjectTransforms(const ON_SimpleArray<const DynamicObject*>&) const
@@ -174,24 +384,107 @@ namespace Osprey
 
     namespace
     {
-        struct Mesh
+        ospray::cpp::Geometry createGeometry(const Mesh& mesh)
         {
-            ON_UUID id;
-            std::vector<ospcommon::math::vec3f> v;
-            std::vector<ospcommon::math::vec3f> n;
-            std::vector<ospcommon::math::vec2f> t;
-            std::vector<ospcommon::math::vec4f> c;
-            std::vector<ospcommon::math::vec3ui> i;
-        };
+            ospray::cpp::Geometry geometry("mesh");
+            if (mesh.v.size())
+            {
+                geometry.setParam("vertex.position", ospray::cpp::Data(mesh.v));
+            }
+            if (mesh.n.size())
+            {
+                geometry.setParam("vertex.normal", ospray::cpp::Data(mesh.n));
+            }
+            if (mesh.t.size())
+            {
+                geometry.setParam("vertex.texcoord", ospray::cpp::Data(mesh.t));
+            }
+            if (mesh.c.size())
+            {
+                geometry.setParam("vertex.color", ospray::cpp::Data(mesh.c));
+            }
+            if (mesh.i.size())
+            {
+                geometry.setParam("index", ospray::cpp::Data(mesh.i));
+            }
+            geometry.commit();
+            return geometry;
+        }
+
+        ospray::cpp::Geometry createGeometry(const Curve& curve)
+        {
+            ospray::cpp::Geometry geometry("curve");
+            geometry.setParam("vertex.position_radius", ospray::cpp::Data(curve.v));
+            geometry.setParam("index", ospray::cpp::Data(curve.i));
+            geometry.setParam("type", static_cast<unsigned char>(OSP_ROUND));
+            geometry.setParam("basis", static_cast<unsigned char>(OSP_LINEAR));
+            geometry.commit();
+            return geometry;
+        }
+
+        void convertCurve(const ON_Curve& onCurve, const ON_Mesh* onPipe, Curve& out)
+        {
+            // Use the radius of the piping mesh that Rhino created for the
+            // curve.
+            float radius = curveRadius;
+            if (onPipe && onPipe->m_V.Count() > 0)
+            {
+                const ON_3dPoint p(onPipe->m_V[0]);
+                double t = 0.0;
+                if (onCurve.GetClosestPoint(p, &t))
+                {
+                    const float d = static_cast<float>(p.DistanceTo(onCurve.PointAt(t)));
+                    if (d > 0.F)
+                    {
+                        radius = d;
+                    }
+                }
+            }
+
+            // Convert the spans to linear segments.
+            const int spanCount = onCurve.SpanCount();
+            if (spanCount <= 0)
+                return;
+            std::vector<double> spans(spanCount + 1);
+            if (!onCurve.GetSpanVector(spans.data()))
+                return;
+            const int segments = onCurve.Degree() > 1 ? curveSpanSegments : 1;
+            out.v.reserve(spanCount * segments + 1);
+            out.i.reserve(spanCount * segments);
+            const ON_3dPoint start = onCurve.PointAt(spans[0]);
+            out.v.emplace_back(ospcommon::math::vec4f(
+                static_cast<float>(start.x),
+                static_cast<float>(start.y),
+                static_cast<float>(start.z),
+                radius));
+            for (int i = 0; i < spanCount; ++i)
+            {
+                for (int j = 1; j <= segments; ++j)
+                {
+                    const double t = spans[i] + (spans[i + 1] - spans[i]) * j / segments;
+                    const ON_3dPoint p = onCurve.PointAt(t);
+                    out.i.push_back(static_cast<uint32_t>(out.v.size() - 1));
+                    out.v.emplace_back(ospcommon::math::vec4f(
+                        static_cast<float>(p.x),
+                        static_cast<float>(p.y),
+                        static_cast<float>(p.z),
+                        radius));
+                }
+            }
+        }
 
         class ConvertMesh
         {
         public:
             ConvertMesh(
                 const ON_SimpleArray<const RhRdk::Realtime::ChangeQueue::Mesh*>& rhinoMeshes,
-                std::map<ON_UUID, std::vector<Osprey::Mesh> >& meshes) :
+                const std::vector<std::shared_ptr<ON_Curve> >& onCurves,
+                std::vector<std::vector<Osprey::Mesh> >& meshes,
+                std::vector<Curve>& curves) :
                 _rhinoMeshes(rhinoMeshes),
-                _meshes(meshes)
+                _onCurves(onCurves),
+                _meshes(meshes),
+                _curves(curves)
             {}
 
             void operator()(const tbb::blocked_range<size_t>& r) const
@@ -199,8 +492,13 @@ namespace Osprey
                 for (size_t i = r.begin(); i != r.end(); ++i)
                 {
                     const auto& onMeshes = _rhinoMeshes[i]->Meshes();
+                    if (_onCurves[i])
+                    {
+                        convertCurve(*_onCurves[i], onMeshes.Count() > 0 ? onMeshes[0] : nullptr, _curves[i]);
+                        continue;
+                    }
                     const int count = onMeshes.Count();
-                    auto& meshes = _meshes[_rhinoMeshes[i]->UuidId()];
+                    auto& meshes = _meshes[i];
                     meshes.resize(count);
                     for (int j = 0; j < count; ++j)
                     {
@@ -256,7 +554,9 @@ namespace Osprey
 
         private:
             const ON_SimpleArray<const RhRdk::Realtime::ChangeQueue::Mesh*>& _rhinoMeshes;
-            std::map<ON_UUID, std::vector<Osprey::Mesh> >& _meshes;
+            const std::vector<std::shared_ptr<ON_Curve> >& _onCurves;
+            std::vector<std::vector<Osprey::Mesh> >& _meshes;
+            std::vector<Curve>& _curves;
         };
 
     } // namespace
@@ -275,50 +575,126 @@ namespace Osprey
             {
                 that->_geometry.erase(j);
             }
+            that->_smallMeshes.erase(*deleted[i]);
+            that->_curves.erase(*deleted[i]);
         }
+        that->_meshEdits.reserve(_meshEdits.size() + addedOrChanged.Count());
 
-        // Add meshes.
+        // Curves are converted from the copies of the curve objects instead
+        // of the piping meshes that Rhino creates for them.
         const int count = addedOrChanged.Count();
-        std::map<ON_UUID, std::vector<Osprey::Mesh> > meshes;
-        for (int i = 0; i < count; ++i)
+        std::vector<std::shared_ptr<ON_Curve> > onCurves(count);
         {
-            meshes[addedOrChanged[i]->UuidId()] = std::vector<Osprey::Mesh>();
+            std::lock_guard<std::mutex> lock(that->_objectMutex);
+            for (int i = 0; i < count; ++i)
+            {
+                const auto j = _curveObjects.find(addedOrChanged[i]->UuidId());
+                if (j != _curveObjects.end())
+                {
+                    onCurves[i] = j->second;
+                }
+            }
         }
-        tbb::parallel_for(tbb::blocked_range<size_t>(0, count), ConvertMesh(addedOrChanged, meshes));
 
-        for (const auto& i : meshes)
+        // Add meshes.
+        std::vector<std::vector<Osprey::Mesh> > meshes(count);
+        std::vector<Osprey::Curve> curves(count);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, count), ConvertMesh(addedOrChanged, onCurves, meshes, curves));
+
+        that->_geometry.reserve(_geometry.size() + count);
+        for (int i = 0; i < count; ++i)
         {
-            auto& list = that->_geometry[i.first];
-            list.clear();
-            for (const auto& j : i.second)
+            const auto& uuid = addedOrChanged[i]->UuidId();
+            auto& data = that->_geometry[uuid];
+            data.geometry.clear();
+            data.triangles.clear();
+            that->_meshEdits[uuid].add();
+
+            // Keep a copy of the curves for batching. The geometry is only
+            // created if an instance of the curve can't be batched.
+            if (onCurves[i])
+            {
+                data.geometry.push_back(ospray::cpp::Geometry());
+                data.triangles.push_back(curves[i].i.size());
+                that->_smallMeshes.erase(uuid);
+                that->_curves[uuid] = std::move(curves[i]);
+                continue;
+            }
+            that->_curves.erase(uuid);
+
+            // Keep a copy of the small meshes for flattening. Like the curves
+            // their geometry is only created if an instance can't be
+            // flattened.
+            bool small = _flattenMeshes;
+            for (const auto& j : meshes[i])
+            {
+                small &= j.i.size() <= flattenTriangleMax;
+            }
+            for (const auto& j : meshes[i])
             {
                 ospray::cpp::Geometry geometry;
-                if (j.i.size())
+                if (!small && j.i.size())
                 {
-                    geometry = ospray::cpp::Geometry("mesh");
-                    if (j.v.size())
-                    {
-                        geometry.setParam("vertex.position", ospray::cpp::Data(j.v));
-                    }
-                    if (j.n.size())
-                    {
-                        geometry.setParam("vertex.normal", ospray::cpp::Data(j.n));
-                    }
-                    if (j.t.size())
-                    {
-                        geometry.setParam("vertex.texcoord", ospray::cpp::Data(j.t));
-                    }
-                    if (j.c.size())
-                    {
-                        geometry.setParam("vertex.color", ospray::cpp::Data(j.c));
-                    }
-                    if (j.i.size())
-                    {
-                        geometry.setParam("index", ospray::cpp::Data(j.i));
-                    }
-                    geometry.commit();
+                    geometry = createGeometry(j);
+                }
+                data.geometry.push_back(geometry);
+                data.triangles.push_back(j.i.size());
+            }
+            if (small)
+            {
+                that->_smallMeshes[uuid] = std::move(meshes[i]);
+            }
+            else
+            {
+                that->_smallMeshes.erase(uuid);
+            }
+        }
+
+        // Rebuild the batches that contain removed meshes, their instances
+        // are removed with the instance changes.
+        for (int i = 0; i < deleted.Count(); ++i)
+        {
+            const auto j = _flattenedByMesh.find(*deleted[i]);
+            if (j == _flattenedByMesh.end())
+                continue;
+            for (const auto k : j->second)
+            {
+                const auto l = _flattened.find(k);
+                if (l == _flattened.end())
+                    continue;
+                const auto m = that->_batches.find(l->second.batch);
+                if (m != that->_batches.end())
+                {
+                    m->second.dirty = true;
+                }
+            }
+        }
+
+        // Flatten the instances of changed meshes again, since the mesh may
+        // have moved to another grid cell, or grown too large to flatten in
+        // which case the instance gets its own geometry.
+        for (int i = 0; i < count; ++i)
+        {
+            const auto j = _flattenedByMesh.find(addedOrChanged[i]->UuidId());
+            if (j == _flattenedByMesh.end())
+                continue;
+            const std::vector<ON__UINT32> instanceIds = j->second;
+            for (const auto k : instanceIds)
+            {
+                const auto l = _flattened.find(k);
+                if (l == _flattened.end())
+                    continue;
+                const FlattenedInstance flattened = l->second;
+                that->_unflatten(k);
+                if (!that->_flatten(k, flattened.meshId, flattened.meshIndex, flattened.batch.materialId))
+                {
+                    that->_addInstance(
+                        k,
+                        flattened.meshId,
+                        flattened.meshIndex,
+                        flattened.batch.materialId,
+                        ospcommon::math::affine3f(ospcommon::math::one));
                 }
-                list.push_back(geometry);
             }
         }
 	}
@@ -332,65 +708,75 @@ namespace Osprey
         that->_instancesInit = true;
 
         // Remove instances.
+        bool edited = false;
         for (int i = 0; i < deleted.Count(); ++i)
         {
             const auto j = _instances.find(deleted[i]);
             if (j != _instances.end())
             {
                 that->_instances.erase(j);
+                edited = true;
             }
+            that->_unflatten(deleted[i]);
+        }
+
+        // Convert the transforms.
+        const int count = addedOrChanged.Count();
+        std::vector<const ON_Xform*> rdkXforms(count);
+        for (int i = 0; i < count; ++i)
+        {
+            rdkXforms[i] = &addedOrChanged[i]->InstanceXform();
         }
+        std::vector<ospcommon::math::affine3f> xforms(count);
+        fromRhino(rdkXforms.data(), count, xforms.data());
 
         // Add instances.
-        for (int i = 0; i < addedOrChanged.Count(); ++i)
+        that->_instances.reserve(_instances.size() + count);
+        for (int i = 0; i < count; ++i)
         {
             const auto rdkInstance = addedOrChanged[i];
             const auto rdkInstanceID = rdkInstance->InstanceId();
             const auto j = _instances.find(rdkInstanceID);
             if (j != _instances.end())
             {
-                j->second.setParam("xfm", fromRhino(rdkInstance->InstanceXform()));
+                j->second.instance.setParam("xfm", xforms[i]);
+                j->second.instance.commit();
+                edited = true;
             }
             else
             {
-                const auto rdkMeshID = rdkInstance->MeshId();
-                const auto k = _geometry.find(rdkMeshID);
-                if (k != _geometry.end())
-                {
-                    const int rdkMeshIndex = rdkInstance->MeshIndex();
-                    if (rdkMeshIndex < k->second.size())
-                    {
-                        const auto& mesh = k->second[rdkMeshIndex];
-                        if (mesh.handle())
-                        {
-                            ospray::cpp::GeometricModel model(mesh);
-                            auto material = that->_getMaterial(MaterialFromId(rdkInstance->MaterialId()));
-                            if (material.handle())
-                            {
-                                model.setParam("material", material);
-                            }
-                            model.commit();
-
-                            ospray::cpp::Group group;
-                            group.setParam("geometry", ospray::cpp::Data(model));
-                            group.commit();
-
-                            ospray::cpp::Instance instance(group);
-                            instance.setParam("xfm", fromRhino(rdkInstance->InstanceXform()));
-                            instance.commit();
-                            that->_instances[rdkInstanceID] = instance;
-                        }
-                    }
-                }
+                // Flattened instances are removed from their batch and
+                // added again in case the material or location changed. Only
+                // geometry that is not instanced can be flattened, which
+                // Rhino gives us with an identity transform.
+                that->_unflatten(rdkInstanceID);
+                if (rdkInstance->InstanceXform().IsIdentity() &&
+                    that->_flatten(rdkInstanceID, rdkInstance->MeshId(), rdkInstance->MeshIndex(), rdkInstance->MaterialId()))
+                    continue;
+
+                that->_addInstance(
+                    rdkInstanceID,
+                    rdkInstance->MeshId(),
+                    rdkInstance->MeshIndex(),
+                    rdkInstance->MaterialId(),
+                    xforms[i]);
             }
         }
+        if (edited)
+        {
+            that->_instanceEdits.add();
+        }
 	}
 
 	void ChangeQueue::ApplySunChanges(const ON_Light& rhinoSun) const
 	{
         auto that = const_cast<ChangeQueue*>(this);
+        uint32_t hash = crc(0, rhinoSun.IsEnabled());
         if (rhinoSun.IsEnabled())
         {
+            hash = crc(hash, rhinoSun.Direction());
+            hash = crc(hash, rhinoSun.Diffuse());
+            hash = crc(hash, rhinoSun.Intensity());
             if (!_sun)
             {
                 that->_lightsInit = true;
@@ -408,11 +794,13 @@ namespace Osprey
             that->_lightsInit = true;
             that->_sun.reset();
         }
+        that->_contentHashes[L"Sun"] = hash;
 	}
 
 	void ChangeQueue::ApplySkylightChanges(const Skylight& rhinoSkylight) const
 	{
         auto that = const_cast<ChangeQueue*>(this);
+        uint32_t hash = crc(0, rhinoSkylight.On());
         if (rhinoSkylight.On())
         {
             if (!_ambient)
@@ -422,6 +810,7 @@ namespace Osprey
             }
 
             const float shadowIntensity = rhinoSkylight.ShadowIntensity();
+            hash = crc(hash, shadowIntensity);
             _ambient->setParam("intensity", ambientIntensity);
             _ambient->commit();
         }
@@ -430,6 +819,7 @@ namespace Osprey
             that->_lightsInit = true;
             that->_ambient.reset();
         }
+        that->_contentHashes[L"Skylight"] = hash;
 	}
 
 	void ChangeQueue::ApplyLightChanges(const ON_SimpleArray<const Light*>& rhinoLights) const
@@ -520,14 +910,14 @@ namespace Osprey
             const auto rdkMaterial = MaterialFromId(rhinoMaterial->MaterialId());
             const std::wstring instanceName = rdkMaterial->InstanceName();
             const auto l = that->_materials.find(instanceName);
-            if (l != _materials.end())
+            if (l != that->_materials.end())
             {
-                _convertMaterial(rdkMaterial, l->second);
+                that->_contentHashes[L"Material " + instanceName] = _convertMaterial(rdkMaterial, l->second);
             }
             else
             {
                 ospray::cpp::Material material(_rendererName, "obj");
-                _convertMaterial(rdkMaterial, material);
+                that->_contentHashes[L"Material " + instanceName] = _convertMaterial(rdkMaterial, material);
                 that->_materials[instanceName] = material;
             }
         }
@@ -538,18 +928,24 @@ namespace Osprey
         auto that = const_cast<ChangeQueue*>(this);
 
         auto id = EnvironmentIdForUsage(usage);
+        uint32_t hash = crc(0, id);
         if (auto rdkEnv = EnvironmentFromId(id))
         {
             CRhRdkSimulatedEnvironment rdkSimEnv;
             rdkEnv->SimulateEnvironment(rdkSimEnv);
+            hash = crc(hash, rdkSimEnv.BackgroundColor());
         }
+        that->_contentHashes[L"Environment " + std::to_wstring(static_cast<int>(usage))] = hash;
     }
 
 	void ChangeQueue::ApplyGroundPlaneChanges(const GroundPlane& rhinoGroundPlane) const
 	{
         auto that = const_cast<ChangeQueue*>(this);
+        uint32_t hash = crc(0, rhinoGroundPlane.Enabled());
         if (rhinoGroundPlane.Enabled())
         {
+            hash = crc(hash, rhinoGroundPlane.Altitude());
+            hash = crc(hash, rhinoGroundPlane.MaterialId());
             that->_instancesInit = true;
 
             auto geometry = ospray::cpp::Geometry("plane");
@@ -561,31 +957,34 @@ namespace Osprey
             geometry.setParam("plane.coefficients", ospray::cpp::Data(coefficients));
             geometry.commit();
 
-            auto model = ospray::cpp::GeometricModel(geometry);
-            auto material = that->_getMaterial(MaterialFromId(rhinoGroundPlane.MaterialId()));
-            if (material.handle())
-            {
-                model.setParam("material", material);
-            }
-            model.commit();
+            auto data = std::make_shared<InstanceData>();
+            data->model = ospray::cpp::GeometricModel(geometry);
+            data->materialId = rhinoGroundPlane.MaterialId();
+            that->_bindMaterial(*data);
 
-            ospray::cpp::Group group;
-            group.setParam("geometry", ospray::cpp::Data(model));
-            group.commit();
+            data->group = ospray::cpp::Group();
+            data->group.setParam("geometry", ospray::cpp::Data(data->model));
+            that->_buildGroup(*data);
 
-            that->_groundPlane = std::make_shared<ospray::cpp::Instance>(group);
-            _groundPlane->commit();
+            data->instance = ospray::cpp::Instance(data->group);
+            data->instance.commit();
+            that->_groundPlane = data;
         }
         else if (_groundPlane)
         {
             that->_instancesInit = true;
             that->_groundPlane.reset();
         }
+        that->_contentHashes[L"GroundPlane"] = hash;
     }
 
-    void ChangeQueue::ApplyLinearWorkflowChanges(const IRhRdkLinearWorkflow&) const
+    void ChangeQueue::ApplyLinearWorkflowChanges(const IRhRdkLinearWorkflow& rdkLinearWorkflow) const
     {
         auto that = const_cast<ChangeQueue*>(this);
+        that->_scene->gamma = rdkLinearWorkflow.PostProcessGammaOn() ?
+            static_cast<float>(rdkLinearWorkflow.PostProcessGamma()) :
+            1.F;
+        that->_contentHashes[L"LinearWorkflow"] = crc(0, _scene->gamma);
     }
 
     void ChangeQueue::ApplyRenderSettingsChanges(const ON_3dmRenderSettings& onRenderSettings) const
@@ -609,6 +1008,14 @@ namespace Osprey
         }
         that->_scene->background.color = fromRhino(onRenderSettings.m_background_color);
         that->_scene->background.color2 = fromRhino(onRenderSettings.m_background_bottom_color);
+
+        uint32_t hash = crc(0, onRenderSettings.m_bCustomImageSize);
+        hash = crc(hash, onRenderSettings.m_image_width);
+        hash = crc(hash, onRenderSettings.m_image_height);
+        hash = crc(hash, onRenderSettings.m_background_style);
+        hash = crc(hash, onRenderSettings.m_background_color);
+        hash = crc(hash, onRenderSettings.m_background_bottom_color);
+        that->_contentHashes[L"RenderSettings"] = hash;
     }
 
     void ChangeQueue::ApplyClippingPlaneChanges(
@@ -616,11 +1023,37 @@ namespace Osprey
         const ON_SimpleArray<const ClippingPlane*>& addedOrChanged) const
     {
         auto that = const_cast<ChangeQueue*>(this);
+        for (int i = 0; i < deleted.Count(); ++i)
+        {
+            that->_clippingPlanes.erase(*deleted[i]);
+        }
+        for (int i = 0; i < addedOrChanged.Count(); ++i)
+        {
+            that->_setClippingPlane(addedOrChanged[i]);
+        }
+        that->_clippingChanged = true;
     }
 
-    void ChangeQueue::ApplyDynamicClippingPlaneChanges(const ON_SimpleArray<const ClippingPlane*>&) const
+    void ChangeQueue::ApplyDynamicClippingPlaneChanges(const ON_SimpleArray<const ClippingPlane*>& planes) const
     {
         auto that = const_cast<ChangeQueue*>(this);
+        for (int i = 0; i < planes.Count(); ++i)
+        {
+            that->_setClippingPlane(planes[i]);
+        }
+        that->_clippingChanged = true;
+    }
+
+    bool ChangeQueue::CameraData::operator == (const CameraData& other) const
+    {
+        return
+            type == other.type &&
+            position == other.position &&
+            direction == other.direction &&
+            up == other.up &&
+            nearClip == other.nearClip &&
+            fovy == other.fovy &&
+            height == other.height;
     }
 
     eRhRdkBakingFunctions ChangeQueue::BakeFor() const
@@ -683,13 +1116,17 @@ namespace Osprey
         out.commit();
     }
 
-    void ChangeQueue::_convertMaterial(const CRhRdkMaterial* rdkMaterial, ospray::cpp::Material& out)
+    uint32_t ChangeQueue::_convertMaterial(const CRhRdkMaterial* rdkMaterial, ospray::cpp::Material& out)
     {
         auto onMaterial = rdkMaterial->SimulatedMaterial();
-        out.setParam("kd", ospcommon::math::vec3f(fromRhino(onMaterial.Diffuse())));
-        out.setParam("ns", static_cast<float>(onMaterial.Shine() / ON_Material::MaxShine) * 100.F);
-        out.setParam("d",  static_cast<float>(1.0 - onMaterial.Transparency()));
+        const ospcommon::math::vec3f kd(fromRhino(onMaterial.Diffuse()));
+        const float ns = static_cast<float>(onMaterial.Shine() / ON_Material::MaxShine) * 100.F;
+        const float d = static_cast<float>(1.0 - onMaterial.Transparency());
+        out.setParam("kd", kd);
+        out.setParam("ns", ns);
+        out.setParam("d", d);
         out.commit();
+        return crc(crc(crc(0, kd), ns), d);
     }
 
     ospray::cpp::Material ChangeQueue::_getMaterial(const CRhRdkMaterial* rdkMaterial)
@@ -704,10 +1141,833 @@ namespace Osprey
         else if (_supportsMaterials)
         {
             out = ospray::cpp::Material(_rendererName, "obj");
-            _convertMaterial(rdkMaterial, out);
+            _contentHashes[L"Material " + instanceName] = _convertMaterial(rdkMaterial, out);
             _materials[instanceName] = out;
         }
         return out;
     }
 
+    void ChangeQueue::_bindMaterial(InstanceData& data)
+    {
+        ospray::cpp::Material material;
+        if (const auto rdkMaterial = MaterialFromId(data.materialId))
+        {
+            material = _getMaterial(rdkMaterial);
+        }
+        if (material.handle())
+        {
+            data.model.setParam("material", material);
+        }
+        else
+        {
+            data.model.removeParam("material");
+        }
+        data.model.commit();
+    }
+
+    void ChangeQueue::_buildGroup(InstanceData& data)
+    {
+        bool dynamicScene = false;
+        bool compactMode = false;
+        switch (_bvhPolicy)
+        {
+        case BVHPolicy::Automatic:
+            // Objects that are being edited get fast, low quality builds and
+            // large static objects get high quality, compact builds.
+            dynamicScene = data.edits >= dynamicEditsMin;
+            compactMode = !dynamicScene && data.triangles >= compactTrianglesMin;
+            break;
+        case BVHPolicy::Static:
+            compactMode = data.triangles >= compactTrianglesMin;
+            break;
+        case BVHPolicy::Dynamic:
+            dynamicScene = true;
+            break;
+        default: break;
+        }
+        data.group.setParam("dynamicScene", dynamicScene);
+        data.group.setParam("compactMode", compactMode);
+
+        const auto t = std::chrono::steady_clock::now();
+        data.group.commit();
+        _buildTime += std::chrono::steady_clock::now() - t;
+        ++_buildCount;
+    }
+
+    size_t ChangeQueue::EditHistory::add()
+    {
+        value = count() + 1;
+        time = std::chrono::steady_clock::now();
+        return value;
+    }
+
+    size_t ChangeQueue::EditHistory::count() const
+    {
+        return std::chrono::steady_clock::now() - time > editWindow ? 0 : value;
+    }
+
+    bool ChangeQueue::BatchKey::operator == (const BatchKey& other) const
+    {
+        return
+            materialId == other.materialId &&
+            curve == other.curve &&
+            x == other.x &&
+            y == other.y &&
+            z == other.z;
+    }
+
+    size_t ChangeQueue::BatchKeyHash::operator () (const BatchKey& value) const
+    {
+        uint64_t h =
+            (static_cast<uint64_t>(value.materialId) * 0x9e3779b97f4a7c15ULL) ^
+            (value.curve ? 0x5bd1e995ULL : 0ULL) ^
+            (static_cast<uint64_t>(static_cast<uint32_t>(value.x)) * 73856093ULL) ^
+            (static_cast<uint64_t>(static_cast<uint32_t>(value.y)) * 19349663ULL) ^
+            (static_cast<uint64_t>(static_cast<uint32_t>(value.z)) * 83492791ULL);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+    void ChangeQueue::_createGeometry(const ON_UUID& uuid, int index, ospray::cpp::Geometry& out)
+    {
+        const auto c = _curves.find(uuid);
+        if (c != _curves.end())
+        {
+            if (0 == index && c->second.i.size())
+            {
+                out = createGeometry(c->second);
+            }
+            return;
+        }
+        const auto m = _smallMeshes.find(uuid);
+        if (m != _smallMeshes.end() &&
+            index >= 0 &&
+            index < static_cast<int>(m->second.size()) &&
+            m->second[index].i.size())
+        {
+            out = createGeometry(m->second[index]);
+        }
+    }
+
+    void ChangeQueue::_addInstance(
+        ON__UINT32 instanceId,
+        const ON_UUID& meshId,
+        int meshIndex,
+        ON__UINT32 materialId,
+        const ospcommon::math::affine3f& xform)
+    {
+        const auto i = _geometry.find(meshId);
+        if (i == _geometry.end() || meshIndex < 0 || meshIndex >= static_cast<int>(i->second.geometry.size()))
+            return;
+        auto& mesh = i->second.geometry[meshIndex];
+        if (!mesh.handle())
+        {
+            _createGeometry(meshId, meshIndex, mesh);
+        }
+        if (!mesh.handle())
+            return;
+
+        InstanceData data;
+        data.model = ospray::cpp::GeometricModel(mesh);
+        data.materialId = materialId;
+        _bindMaterial(data);
+
+        data.group = ospray::cpp::Group();
+        data.group.setParam("geometry", ospray::cpp::Data(data.model));
+        data.triangles = i->second.triangles[meshIndex];
+        const auto j = _meshEdits.find(meshId);
+        data.edits = j != _meshEdits.end() ? j->second.count() : 0;
+        _buildGroup(data);
+
+        data.instance = ospray::cpp::Instance(data.group);
+        data.instance.setParam("xfm", xform);
+        data.instance.commit();
+        _instances[instanceId] = data;
+        _instancesInit = true;
+    }
+
+    bool ChangeQueue::_flatten(ON__UINT32 instanceId, const ON_UUID& meshId, int meshIndex, ON__UINT32 materialId)
+    {
+        ospcommon::math::vec3f lower;
+        ospcommon::math::vec3f upper;
+        bool curve = false;
+        const auto c = _curves.find(meshId);
+        if (c != _curves.end())
+        {
+            // Curves are always batched since they are small, and the
+            // batches are the main benefit of converting them.
+            const auto& v = c->second.v;
+            if (meshIndex != 0 || c->second.i.empty())
+                return false;
+            lower = upper = ospcommon::math::vec3f(v[0].x, v[0].y, v[0].z);
+            for (const auto& i : v)
+            {
+                lower = ospcommon::math::min(lower, ospcommon::math::vec3f(i.x, i.y, i.z));
+                upper = ospcommon::math::max(upper, ospcommon::math::vec3f(i.x, i.y, i.z));
+            }
+            curve = true;
+        }
+        else
+        {
+            if (!_flattenMeshes)
+                return false;
+            const auto i = _smallMeshes.find(meshId);
+            if (i == _smallMeshes.end())
+                return false;
+            if (meshIndex < 0 || meshIndex >= static_cast<int>(i->second.size()))
+                return false;
+            const auto& mesh = i->second[meshIndex];
+            if (mesh.v.empty() || mesh.i.empty())
+                return false;
+            lower = upper = mesh.v[0];
+            for (const auto& v : mesh.v)
+            {
+                lower = ospcommon::math::min(lower, v);
+                upper = ospcommon::math::max(upper, v);
+            }
+        }
+
+        // Find the grid cell from the center of the bounds so that the
+        // batches are spatially coherent.
+        const ospcommon::math::vec3f center = (lower + upper) * .5F;
+
+        FlattenedInstance flattened;
+        flattened.meshId = meshId;
+        flattened.meshIndex = meshIndex;
+        flattened.batch.materialId = materialId;
+        flattened.batch.curve = curve;
+        flattened.batch.x = static_cast<int>(std::floor(center.x / flattenCellSize));
+        flattened.batch.y = static_cast<int>(std::floor(center.y / flattenCellSize));
+        flattened.batch.z = static_cast<int>(std::floor(center.z / flattenCellSize));
+
+        auto& batch = _batches[flattened.batch];
+        batch.instanceIds.push_back(instanceId);
+        batch.dirty = true;
+        _flattened[instanceId] = flattened;
+        _flattenedByMesh[meshId].push_back(instanceId);
+        return true;
+    }
+
+    void ChangeQueue::_unflatten(ON__UINT32 rdkInstanceID)
+    {
+        const auto i = _flattened.find(rdkInstanceID);
+        if (i == _flattened.end())
+            return;
+        const auto j = _batches.find(i->second.batch);
+        if (j != _batches.end())
+        {
+            auto& instanceIds = j->second.instanceIds;
+            instanceIds.erase(std::remove(instanceIds.begin(), instanceIds.end(), rdkInstanceID), instanceIds.end());
+            j->second.dirty = true;
+        }
+        const auto k = _flattenedByMesh.find(i->second.meshId);
+        if (k != _flattenedByMesh.end())
+        {
+            auto& instanceIds = k->second;
+            instanceIds.erase(std::remove(instanceIds.begin(), instanceIds.end(), rdkInstanceID), instanceIds.end());
+            if (instanceIds.empty())
+            {
+                _flattenedByMesh.erase(k);
+            }
+        }
+        _flattened.erase(i);
+    }
+
+    void ChangeQueue::_updateBatches()
+    {
+        std::vector<BatchKey> empty;
+        for (auto& i : _batches)
+        {
+            auto& batch = i.second;
+            if (!batch.dirty)
+                continue;
+            batch.dirty = false;
+            _instancesInit = true;
+
+            ospray::cpp::Geometry geometry;
+            const size_t primitives = i.first.curve ?
+                _mergeCurves(batch, geometry) :
+                _mergeMeshes(batch, geometry);
+            if (!primitives)
+            {
+                empty.push_back(i.first);
+                continue;
+            }
+
+            if (!batch.data)
+            {
+                batch.data = std::make_shared<InstanceData>();
+            }
+            batch.data->model = ospray::cpp::GeometricModel(geometry);
+            batch.data->materialId = i.first.materialId;
+            _bindMaterial(*batch.data);
+
+            batch.data->group = ospray::cpp::Group();
+            batch.data->group.setParam("geometry", ospray::cpp::Data(batch.data->model));
+            batch.data->triangles = primitives;
+            batch.data->edits = batch.edits.add();
+            _buildGroup(*batch.data);
+
+            batch.data->instance = ospray::cpp::Instance(batch.data->group);
+            batch.data->instance.commit();
+        }
+        for (const auto& i : empty)
+        {
+            _batches.erase(i);
+        }
+    }
+
+    size_t ChangeQueue::_mergeMeshes(Batch& batch, ospray::cpp::Geometry& geometry)
+    {
+        // Gather the meshes. The optional vertex attributes are only kept
+        // when every mesh in the batch has them.
+        std::vector<std::pair<uint32_t, const Osprey::Mesh*> > meshes;
+        meshes.reserve(batch.instanceIds.size());
+        size_t vertexCount = 0;
+        size_t triangleCount = 0;
+        bool normals = true;
+        bool texcoords = true;
+        bool colors = true;
+        for (size_t j = 0; j < batch.instanceIds.size(); ++j)
+        {
+            const auto k = _flattened.find(batch.instanceIds[j]);
+            if (k == _flattened.end())
+                continue;
+            const auto l = _smallMeshes.find(k->second.meshId);
+            if (l == _smallMeshes.end() || k->second.meshIndex >= static_cast<int>(l->second.size()))
+                continue;
+            const auto& mesh = l->second[k->second.meshIndex];
+            normals = normals && mesh.n.size() == mesh.v.size();
+            texcoords = texcoords && mesh.t.size() == mesh.v.size();
+            colors = colors && mesh.c.size() == mesh.v.size();
+            vertexCount += mesh.v.size();
+            triangleCount += mesh.i.size();
+            meshes.push_back(std::make_pair(static_cast<uint32_t>(j), &mesh));
+        }
+        if (!triangleCount)
+            return 0;
+
+        // Merge the meshes, keeping the mapping from each triangle back to
+        // the instance it came from.
+        Osprey::Mesh merged;
+        merged.v.reserve(vertexCount);
+        if (normals)
+        {
+            merged.n.reserve(vertexCount);
+        }
+        if (texcoords)
+        {
+            merged.t.reserve(vertexCount);
+        }
+        if (colors)
+        {
+            merged.c.reserve(vertexCount);
+        }
+        merged.i.reserve(triangleCount);
+        batch.primitiveInstances.clear();
+        batch.primitiveInstances.reserve(triangleCount);
+        for (const auto& j : meshes)
+        {
+            const auto& mesh = *j.second;
+            const ospcommon::math::vec3ui offset(static_cast<uint32_t>(merged.v.size()));
+            merged.v.insert(merged.v.end(), mesh.v.begin(), mesh.v.end());
+            if (normals)
+            {
+                merged.n.insert(merged.n.end(), mesh.n.begin(), mesh.n.end());
+            }
+            if (texcoords)
+            {
+                merged.t.insert(merged.t.end(), mesh.t.begin(), mesh.t.end());
+            }
+            if (colors)
+            {
+                merged.c.insert(merged.c.end(), mesh.c.begin(), mesh.c.end());
+            }
+            for (const auto& k : mesh.i)
+            {
+                merged.i.push_back(k + offset);
+            }
+            batch.primitiveInstances.insert(batch.primitiveInstances.end(), mesh.i.size(), j.first);
+        }
+        geometry = createGeometry(merged);
+        return triangleCount;
+    }
+
+    size_t ChangeQueue::_mergeCurves(Batch& batch, ospray::cpp::Geometry& geometry)
+    {
+        std::vector<std::pair<uint32_t, const Osprey::Curve*> > curves;
+        curves.reserve(batch.instanceIds.size());
+        size_t vertexCount = 0;
+        size_t segmentCount = 0;
+        for (size_t j = 0; j < batch.instanceIds.size(); ++j)
+        {
+            const auto k = _flattened.find(batch.instanceIds[j]);
+            if (k == _flattened.end())
+                continue;
+            const auto l = _curves.find(k->second.meshId);
+            if (l == _curves.end())
+                continue;
+            vertexCount += l->second.v.size();
+            segmentCount += l->second.i.size();
+            curves.push_back(std::make_pair(static_cast<uint32_t>(j), &l->second));
+        }
+        if (!segmentCount)
+            return 0;
+
+        // Merge the curves, keeping the mapping from each segment back to
+        // the instance it came from.
+        Osprey::Curve merged;
+        merged.v.reserve(vertexCount);
+        merged.i.reserve(segmentCount);
+        batch.primitiveInstances.clear();
+        batch.primitiveInstances.reserve(segmentCount);
+        for (const auto& j : curves)
+        {
+            const auto& curve = *j.second;
+            const uint32_t offset = static_cast<uint32_t>(merged.v.size());
+            merged.v.insert(merged.v.end(), curve.v.begin(), curve.v.end());
+            for (const auto k : curve.i)
+            {
+                merged.i.push_back(k + offset);
+            }
+            batch.primitiveInstances.insert(batch.primitiveInstances.end(), curve.i.size(), j.first);
+        }
+        geometry = createGeometry(merged);
+        return segmentCount;
+    }
+
+    void ChangeQueue::_convertPointCloud(const ON_PointCloud& onPointCloud, PointCloudData& out)
+    {
+        const size_t count = onPointCloud.PointCount();
+        const ON_BoundingBox bbox = onPointCloud.BoundingBox();
+        const ON_3dVector size = bbox.Diagonal();
+
+        // Sort the points by their Morton code within the bounds so that
+        // the chunks are spatially coherent.
+        std::vector<std::pair<uint32_t, uint32_t> > order(count);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, count), [&](const tbb::blocked_range<size_t>& r)
+        {
+            for (size_t i = r.begin(); i != r.end(); ++i)
+            {
+                const ON_3dPoint& p = onPointCloud.m_P[static_cast<int>(i)];
+                uint32_t q[3] = { 0, 0, 0 };
+                for (int j = 0; j < 3; ++j)
+                {
+                    if (size[j] > 0.0)
+                    {
+                        q[j] = static_cast<uint32_t>(std::min(std::max((p[j] - bbox.m_min[j]) / size[j], 0.0), 1.0) * 1023.0);
+                    }
+                }
+                order[i] = std::make_pair(
+                    (expandBits(q[0]) << 2) | (expandBits(q[1]) << 1) | expandBits(q[2]),
+                    static_cast<uint32_t>(i));
+            }
+        });
+        tbb::parallel_sort(order.begin(), order.end());
+
+        // Shuffle the points within each chunk.
+        out.chunks.clear();
+        for (size_t i = 0; i < count; i += pointChunkSize)
+        {
+            out.chunks.push_back(i);
+            std::mt19937 random(static_cast<uint32_t>(i));
+            std::shuffle(order.begin() + i, order.begin() + std::min(i + pointChunkSize, count), random);
+        }
+        out.chunks.push_back(count);
+
+        // Copy the positions and colors.
+        const bool colors = onPointCloud.HasPointColors();
+        out.positions.resize(count);
+        out.colors.resize(colors ? count : 0);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, count), [&](const tbb::blocked_range<size_t>& r)
+        {
+            for (size_t i = r.begin(); i != r.end(); ++i)
+            {
+                const int j = static_cast<int>(order[i].second);
+                const ON_3dPoint& p = onPointCloud.m_P[j];
+                out.positions[i] = ospcommon::math::vec3f(
+                    static_cast<float>(p.x),
+                    static_cast<float>(p.y),
+                    static_cast<float>(p.z));
+                if (colors)
+                {
+                    const ON_Color& c = onPointCloud.m_C[j];
+                    out.colors[i] = ospcommon::math::vec4f(
+                        static_cast<float>(c.FractionRed()),
+                        static_cast<float>(c.FractionGreen()),
+                        static_cast<float>(c.FractionBlue()),
+                        1.F);
+                }
+            }
+        });
+
+        // Estimate the point spacing, assuming the points are scanned
+        // surfaces spanning the two largest dimensions of the bounds.
+        double d[3] = { size.x, size.y, size.z };
+        std::sort(d, d + 3);
+        double spacing = 0.0;
+        if (d[1] > 0.0)
+        {
+            spacing = sqrt(d[1] * d[2] / count);
+        }
+        else if (d[2] > 0.0)
+        {
+            spacing = d[2] / count;
+        }
+        out.radius = spacing > 0.0 ? static_cast<float>(spacing) * pointRadiusScale : pointRadiusScale;
+    }
+
+    ChangeQueue::ObjectWatcher::ObjectWatcher(ChangeQueue& changeQueue) :
+        _changeQueue(changeQueue)
+    {}
+
+    void ChangeQueue::ObjectWatcher::OnAddObject(CRhinoDoc& rhinoDoc, CRhinoObject& rhinoObject)
+    {
+        if (rhinoDoc.RuntimeSerialNumber() == _changeQueue._rhinoDoc.RuntimeSerialNumber())
+        {
+            _changeQueue._addObject(rhinoObject);
+        }
+    }
+
+    void ChangeQueue::ObjectWatcher::OnDeleteObject(CRhinoDoc& rhinoDoc, CRhinoObject& rhinoObject)
+    {
+        if (rhinoDoc.RuntimeSerialNumber() == _changeQueue._rhinoDoc.RuntimeSerialNumber())
+        {
+            _changeQueue._removeObject(rhinoObject);
+        }
+    }
+
+    void ChangeQueue::ObjectWatcher::OnUnDeleteObject(CRhinoDoc& rhinoDoc, CRhinoObject& rhinoObject)
+    {
+        OnAddObject(rhinoDoc, rhinoObject);
+    }
+
+    void ChangeQueue::ObjectWatcher::OnModifyObjectAttributes(
+        CRhinoDoc& rhinoDoc,
+        CRhinoObject& rhinoObject,
+        const CRhinoObjectAttributes&)
+    {
+        // The visibility or the color may have changed.
+        OnAddObject(rhinoDoc, rhinoObject);
+    }
+
+    void ChangeQueue::ObjectWatcher::LayerTableEvent(
+        layer_event event,
+        const CRhinoLayerTable& layerTable,
+        int layerIndex,
+        const ON_Layer*)
+    {
+        // The visibility or the color of the objects on the layer may have
+        // changed.
+        if (CRhinoEventWatcher::layer_modified == event &&
+            &layerTable == &_changeQueue._rhinoDoc.m_layer_table &&
+            layerIndex >= 0 && layerIndex < layerTable.LayerCount())
+        {
+            _changeQueue._updateLayer(layerIndex, layerTable[layerIndex].IsVisible());
+        }
+    }
+
+    void ChangeQueue::_addObjects()
+    {
+        CRhinoObjectIterator it(
+            _rhinoDoc,
+            CRhinoObjectIterator::normal_or_locked_objects,
+            CRhinoObjectIterator::active_objects);
+        it.SetObjectFilter(static_cast<ON::object_type>(ON::curve_object | ON::pointset_object));
+        for (const CRhinoObject* rhinoObject = it.First(); rhinoObject; rhinoObject = it.Next())
+        {
+            _addObject(*rhinoObject);
+        }
+    }
+
+    void ChangeQueue::_updateLayer(int layerIndex, bool visible)
+    {
+        // The objects on a hidden layer are not normal objects, so all of
+        // the objects are checked to remove them.
+        CRhinoObjectIterator it(
+            _rhinoDoc,
+            CRhinoObjectIterator::undeleted_objects,
+            CRhinoObjectIterator::active_objects);
+        it.SetObjectFilter(static_cast<ON::object_type>(ON::curve_object | ON::pointset_object));
+        for (const CRhinoObject* rhinoObject = it.First(); rhinoObject; rhinoObject = it.Next())
+        {
+            if (rhinoObject->Attributes().m_layer_index == layerIndex)
+            {
+                if (visible)
+                {
+                    _addObject(*rhinoObject);
+                }
+                else
+                {
+                    _removeObject(*rhinoObject);
+                }
+            }
+        }
+    }
+
+    void ChangeQueue::_addObject(const CRhinoObject& rhinoObject)
+    {
+        const ON::object_type type = rhinoObject.ObjectType();
+        if (type != ON::curve_object && type != ON::pointset_object)
+            return;
+        const ON_PointCloud* onPointCloud = ON_PointCloud::Cast(rhinoObject.Geometry());
+        if (ON::pointset_object == type &&
+            (!onPointCloud || 0 == onPointCloud->PointCount() || !rhinoObject.IsVisible()))
+        {
+            _removeObject(rhinoObject);
+            return;
+        }
+
+        // Attribute and layer changes keep the document object, so the
+        // geometry is only copied when the object was replaced.
+        const ON_UUID& uuid = rhinoObject.Attributes().m_uuid;
+        ObjectState state;
+        state.serialNumber = rhinoObject.RuntimeSerialNumber();
+        state.color = rhinoObject.ObjectDrawColor(true);
+        const auto i = _objectStates.find(uuid);
+        const bool geometryChanged = i == _objectStates.end() || i->second.serialNumber != state.serialNumber;
+        if (!geometryChanged && i->second.color == state.color)
+            return;
+        _objectStates[uuid] = state;
+
+        if (ON::curve_object == type)
+        {
+            // The change queue reports the curve piping meshes, the curve is
+            // found here when they are applied.
+            if (geometryChanged)
+            {
+                if (const ON_Curve* onCurve = ON_Curve::Cast(rhinoObject.Geometry()))
+                {
+                    std::shared_ptr<ON_Curve> curve(onCurve->DuplicateCurve());
+                    std::lock_guard<std::mutex> lock(_objectMutex);
+                    _curveObjects[uuid] = curve;
+                }
+            }
+            return;
+        }
+
+        PointCloudChange change;
+        if (geometryChanged)
+        {
+            change.pointCloud = std::make_shared<ON_PointCloud>(*onPointCloud);
+        }
+        change.color = ospcommon::math::vec3f(
+            static_cast<float>(state.color.FractionRed()),
+            static_cast<float>(state.color.FractionGreen()),
+            static_cast<float>(state.color.FractionBlue()));
+        {
+            // A color change keeps a point cloud that is not converted yet.
+            std::lock_guard<std::mutex> lock(_objectMutex);
+            auto& pending = _pointCloudChanges[uuid];
+            if (!change.pointCloud && !pending.removed)
+            {
+                change.pointCloud = pending.pointCloud;
+            }
+            pending = change;
+        }
+        NotifyEndUpdates();
+    }
+
+    void ChangeQueue::_removeObject(const CRhinoObject& rhinoObject)
+    {
+        const ON::object_type type = rhinoObject.ObjectType();
+        if (type != ON::curve_object && type != ON::pointset_object)
+            return;
+        const ON_UUID& uuid = rhinoObject.Attributes().m_uuid;
+        if (!_objectStates.erase(uuid))
+            return;
+        if (ON::curve_object == type)
+        {
+            std::lock_guard<std::mutex> lock(_objectMutex);
+            _curveObjects.erase(uuid);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_objectMutex);
+            PointCloudChange change;
+            change.removed = true;
+            _pointCloudChanges[uuid] = change;
+        }
+        NotifyEndUpdates();
+    }
+
+    void ChangeQueue::_updatePointClouds()
+    {
+        // Convert the point clouds that changed since the last flush.
+        FlatMap<ON_UUID, PointCloudChange> changes;
+        {
+            std::lock_guard<std::mutex> lock(_objectMutex);
+            std::swap(changes, _pointCloudChanges);
+        }
+        std::vector<std::shared_ptr<PointCloudData> > changed;
+        bool removed = false;
+        for (const auto& i : changes)
+        {
+            if (i.second.removed)
+            {
+                removed |= _pointClouds.erase(i.first);
+            }
+            else if (i.second.pointCloud)
+            {
+                auto data = std::make_shared<PointCloudData>();
+                _convertPointCloud(*i.second.pointCloud, *data);
+                data->color = i.second.color;
+                _pointClouds[i.first] = data;
+                changed.push_back(data);
+            }
+            else
+            {
+                // Only the color changed, which is not used when the points
+                // have their own colors.
+                const auto j = _pointClouds.find(i.first);
+                if (j != _pointClouds.end())
+                {
+                    j->second->color = i.second.color;
+                    if (j->second->colors.empty())
+                    {
+                        changed.push_back(j->second);
+                    }
+                }
+            }
+        }
+
+        // The point budget is shared by all of the point clouds, when the
+        // fraction of the points that are used changes all of the point
+        // clouds are built again.
+        size_t total = 0;
+        for (const auto& i : _pointClouds)
+        {
+            total += i.second->positions.size();
+        }
+        const float fraction = _pointBudget > 0 && total > _pointBudget ?
+            _pointBudget / static_cast<float>(total) :
+            1.F;
+        if (_pointCloudsInit || fraction != _pointFraction)
+        {
+            _pointCloudsInit = false;
+            _pointFraction = fraction;
+            for (auto& i : _pointClouds)
+            {
+                _buildPointCloud(*i.second, fraction);
+            }
+            _instancesInit = true;
+        }
+        else if (changed.size() || removed)
+        {
+            for (const auto& i : changed)
+            {
+                _buildPointCloud(*i, fraction);
+            }
+            _instancesInit = true;
+        }
+    }
+
+    void ChangeQueue::_buildPointCloud(PointCloudData& data, float fraction)
+    {
+        ospray::cpp::Material material;
+        if (_supportsMaterials)
+        {
+            // The point colors multiply the material color.
+            material = ospray::cpp::Material(_rendererName, "obj");
+            material.setParam("kd", data.colors.size() ? ospcommon::math::vec3f(1.F) : data.color);
+            material.commit();
+        }
+
+        // The positions and colors are shared with OSPRay. Only the first
+        // points of each chunk are used when the point budget applies, with
+        // larger spheres to cover the same area.
+        const float radius = data.radius / sqrtf(fraction);
+        std::vector<ospray::cpp::GeometricModel> models;
+        for (size_t i = 0; i + 1 < data.chunks.size(); ++i)
+        {
+            const size_t start = data.chunks[i];
+            const size_t count = std::max(
+                static_cast<size_t>(std::ceil((data.chunks[i + 1] - start) * fraction)),
+                size_t(1));
+            ospray::cpp::Geometry geometry("sphere");
+            geometry.setParam("sphere.position", ospray::cpp::Data(count, data.positions.data() + start, true));
+            geometry.setParam("radius", radius);
+            geometry.commit();
+
+            ospray::cpp::GeometricModel model(geometry);
+            if (data.colors.size())
+            {
+                model.setParam("color", ospray::cpp::Data(count, data.colors.data() + start, true));
+            }
+            if (material.handle())
+            {
+                model.setParam("material", material);
+            }
+            model.commit();
+            models.push_back(model);
+        }
+
+        data.group = ospray::cpp::Group();
+        data.group.setParam("geometry", ospray::cpp::Data(models));
+        const auto t = std::chrono::steady_clock::now();
+        data.group.commit();
+        _buildTime += std::chrono::steady_clock::now() - t;
+        ++_buildCount;
+
+        data.instance = ospray::cpp::Instance(data.group);
+        data.instance.commit();
+    }
+
+    void ChangeQueue::_setClippingPlane(const ClippingPlane* rdkClippingPlane)
+    {
+        // Rhino keeps the points where the plane equation is less than or
+        // equal to zero, and OSPRay keeps the side the plane normal points
+        // to, so the equation is negated.
+        const ON_ClippingPlane& onClippingPlane = rdkClippingPlane->ClippingPlane();
+        const ON_PlaneEquation& e = onClippingPlane.m_plane.plane_equation;
+        auto& data = _clippingPlanes[onClippingPlane.m_plane_id];
+        data.coefficients = ospcommon::math::vec4f(
+            static_cast<float>(-e.x),
+            static_cast<float>(-e.y),
+            static_cast<float>(-e.z),
+            static_cast<float>(-e.d));
+        data.viewportIds = onClippingPlane.m_viewport_ids;
+        data.enabled = onClippingPlane.m_bEnabled;
+    }
+
+    bool ChangeQueue::_updateClipping()
+    {
+        std::vector<ospcommon::math::vec4f> coefficients;
+        for (const auto& i : _clippingPlanes)
+        {
+            if (i.second.enabled && i.second.viewportIds.FindUuid(_viewportId))
+            {
+                coefficients.push_back(i.second.coefficients);
+            }
+        }
+        if (coefficients.empty())
+        {
+            if (_clipping)
+            {
+                _clipping.reset();
+                _instancesInit = true;
+            }
+            return false;
+        }
+
+        if (!_clipping)
+        {
+            _clipping = std::make_shared<ClippingData>();
+            _clipping->geometry = ospray::cpp::Geometry("plane");
+            _clipping->model = ospray::cpp::GeometricModel(_clipping->geometry);
+            _clipping->model.commit();
+            _clipping->group = ospray::cpp::Group();
+            _clipping->group.setParam("clippingGeometry", ospray::cpp::Data(_clipping->model));
+            _clipping->instance = ospray::cpp::Instance(_clipping->group);
+            _instancesInit = true;
+        }
+        _clipping->geometry.setParam("plane.coefficients", ospray::cpp::Data(coefficients));
+        _clipping->geometry.commit();
+        _clipping->group.commit();
+        _clipping->instance.commit();
+        return true;
+    }
+
 } // namespace Osprey
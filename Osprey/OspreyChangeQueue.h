@@ -3,11 +3,11 @@
 
 #pragma once
 
+#include "OspreyData.h"
+#include "OspreyFlatMap.h"
+
 namespace Osprey
 {
-    struct Scene;
-    struct Update;
-
     class ChangeQueue : public RhRdk::Realtime::ChangeQueue
     {
 	public:
@@ -20,6 +20,23 @@ namespace Osprey
 
         void setRendererName(const std::string&, bool supportsMaterials = true);
 
+        //! Set whether small meshes are flattened into merged batches. Returns
+        //! true if the value changed, in which case the world needs to be
+        //! created again.
+        bool setFlattenMeshes(bool);
+
+        //! Set the policy for building the BVH acceleration structures.
+        void setBVHPolicy(BVHPolicy);
+
+        //! Set the maximum number of point cloud points that are rendered,
+        //! zero renders every point.
+        void setPointBudget(size_t);
+
+        //! Get a hash of the render content that has been applied: the
+        //! materials, environment, sun, skylight, ground plane, and render
+        //! settings.
+        uint32_t getContentHash() const;
+
         void Flush(bool bApplyChanges = true) override;
 
         void NotifyBeginUpdates() const override;
@@ -46,26 +63,238 @@ namespace Osprey
         bool ProvideOriginalObject() const override;
 
     private:
+        struct GeometryData
+        {
+            std::vector<ospray::cpp::Geometry> geometry;
+            std::vector<size_t> triangles;
+        };
+
+        struct InstanceData
+        {
+            ospray::cpp::Instance instance;
+            ospray::cpp::Group group{ nullptr };
+            ospray::cpp::GeometricModel model;
+            ON__UINT32 materialId = 0;
+            size_t triangles = 0;
+            size_t edits = 0;
+        };
+
+        //! This struct counts the recent edits of an object, edits older than
+        //! the edit window are forgotten.
+        struct EditHistory
+        {
+            size_t value = 0;
+            std::chrono::steady_clock::time_point time;
+
+            size_t add();
+            size_t count() const;
+        };
+
+        //! Small meshes that are not instanced are merged into batches by
+        //! material and by a grid cell of their location. Curves are merged
+        //! into separate batches.
+        struct BatchKey
+        {
+            ON__UINT32 materialId = 0;
+            bool curve = false;
+            int x = 0;
+            int y = 0;
+            int z = 0;
+
+            bool operator == (const BatchKey&) const;
+        };
+
+        struct BatchKeyHash
+        {
+            size_t operator () (const BatchKey&) const;
+        };
+
+        struct Batch
+        {
+            std::vector<ON__UINT32> instanceIds;
+            //! The index into instanceIds for each triangle of the merged mesh.
+            std::vector<uint32_t> primitiveInstances;
+            std::shared_ptr<InstanceData> data;
+            EditHistory edits;
+            bool dirty = true;
+        };
+
+        struct FlattenedInstance
+        {
+            ON_UUID meshId = ON_nil_uuid;
+            int meshIndex = 0;
+            BatchKey batch;
+        };
+
+        //! Point clouds are split into chunks of nearby points. The points
+        //! within each chunk are shuffled so that the point budget can use
+        //! the first points of each chunk as a uniform subset.
+        struct PointCloudData
+        {
+            std::vector<ospcommon::math::vec3f> positions;
+            std::vector<ospcommon::math::vec4f> colors;
+            //! The start of each chunk, followed by the number of points.
+            std::vector<size_t> chunks;
+            float radius = 0.F;
+            ospcommon::math::vec3f color;
+            ospray::cpp::Group group{ nullptr };
+            ospray::cpp::Instance instance;
+        };
+
+        //! A point cloud that changed in the document. The point cloud is
+        //! null when only the color changed.
+        struct PointCloudChange
+        {
+            std::shared_ptr<ON_PointCloud> pointCloud;
+            ospcommon::math::vec3f color;
+            bool removed = false;
+        };
+
+        //! The document object that a curve or point cloud was last copied
+        //! from. The geometry of a document object doesn't change, so it is
+        //! only copied again when the object is replaced.
+        struct ObjectState
+        {
+            unsigned int serialNumber = 0;
+            ON_Color color;
+        };
+
+        //! This class watches the document for the curves and point clouds,
+        //! which are not converted from the meshes in the change queue. The
+        //! events are received on the UI thread, so the change queue never
+        //! reads the document while it is flushed.
+        class ObjectWatcher : public CRhinoEventWatcher
+        {
+        public:
+            ObjectWatcher(ChangeQueue&);
+
+            void OnAddObject(CRhinoDoc&, CRhinoObject&) override;
+            void OnDeleteObject(CRhinoDoc&, CRhinoObject&) override;
+            void OnUnDeleteObject(CRhinoDoc&, CRhinoObject&) override;
+            void OnModifyObjectAttributes(CRhinoDoc&, CRhinoObject&, const CRhinoObjectAttributes&) override;
+            void LayerTableEvent(layer_event, const CRhinoLayerTable&, int layerIndex, const ON_Layer*) override;
+
+        private:
+            ChangeQueue& _changeQueue;
+        };
+
+        struct ClippingPlaneData
+        {
+            ospcommon::math::vec4f coefficients;
+            ON_UuidList viewportIds;
+            bool enabled = true;
+        };
+
+        //! The clipping planes are combined in a single plane geometry, so
+        //! that moving a plane only updates the plane coefficients.
+        struct ClippingData
+        {
+            ospray::cpp::Geometry geometry;
+            ospray::cpp::GeometricModel model;
+            ospray::cpp::Group group{ nullptr };
+            ospray::cpp::Instance instance;
+        };
+
+        //! The camera parameters of the last view change.
+        struct CameraData
+        {
+            std::string type;
+            ospcommon::math::vec3f position;
+            ospcommon::math::vec3f direction;
+            ospcommon::math::vec3f up;
+            float nearClip = 0.F;
+            float fovy = 0.F;
+            float height = 0.F;
+
+            bool operator == (const CameraData&) const;
+        };
+
         static void _convertMesh(const ON_Mesh*, Mesh&);
         static void _convertLight(const ON_Light&, const ON_Viewport&, ospray::cpp::Light&);
-        static void _convertMaterial(const CRhRdkMaterial*, ospray::cpp::Material&);
+        //! Convert a material. Returns a CRC of the converted values.
+        static uint32_t _convertMaterial(const CRhRdkMaterial*, ospray::cpp::Material&);
+        static void _convertPointCloud(const ON_PointCloud&, PointCloudData&);
         ospray::cpp::Material _getMaterial(const CRhRdkMaterial*);
+        void _bindMaterial(InstanceData&);
+        void _buildGroup(InstanceData&);
+        //! Create the geometry of a curve or a small mesh that was kept for
+        //! batching, when an instance of it can't be batched.
+        void _createGeometry(const ON_UUID&, int index, ospray::cpp::Geometry&);
+        //! Add an instance of a mesh that is not flattened.
+        void _addInstance(
+            ON__UINT32 instanceId,
+            const ON_UUID& meshId,
+            int meshIndex,
+            ON__UINT32 materialId,
+            const ospcommon::math::affine3f&);
+        //! Add an instance with an identity transform to a batch. Returns
+        //! false if the mesh can't be flattened.
+        bool _flatten(ON__UINT32 instanceId, const ON_UUID& meshId, int meshIndex, ON__UINT32 materialId);
+        void _unflatten(ON__UINT32);
+        void _updateBatches();
+
+        //! Merge the geometry of a batch. Returns the number of primitives.
+        size_t _mergeMeshes(Batch&, ospray::cpp::Geometry&);
+        size_t _mergeCurves(Batch&, ospray::cpp::Geometry&);
+
+        //! Curves and point clouds are copied from the document events on the
+        //! UI thread. The point clouds are converted when the change queue is
+        //! flushed, and the curves when their piping meshes are applied.
+        void _addObjects();
+        void _updateLayer(int layerIndex, bool visible);
+        void _addObject(const CRhinoObject&);
+        void _removeObject(const CRhinoObject&);
+        void _updatePointClouds();
+        void _buildPointCloud(PointCloudData&, float fraction);
+
+        void _setClippingPlane(const ClippingPlane*);
+
+        //! Update the clipping geometry. Returns true if the world needs to
+        //! be committed.
+        bool _updateClipping();
 
         const CRhinoDoc& _rhinoDoc;
         std::shared_ptr<Update> _update;
         std::shared_ptr<Scene> _scene;
         std::string _rendererName;
         bool _supportsMaterials = true;
-        std::map<ON_UUID, std::vector<ospray::cpp::Geometry> > _geometry;
+        FlatMap<ON_UUID, GeometryData> _geometry;
         //! \todo Is the material instance name the right key to use?
-        std::map<const std::wstring, ospray::cpp::Material> _materials;
-        std::map<ON__UINT32, ospray::cpp::Instance> _instances;
-        std::shared_ptr<ospray::cpp::Instance> _groundPlane;
+        FlatMap<std::wstring, ospray::cpp::Material> _materials;
+        FlatMap<ON__UINT32, InstanceData> _instances;
+        std::shared_ptr<InstanceData> _groundPlane;
         bool _instancesInit = true;
+        bool _flattenMeshes = false;
+        FlatMap<ON_UUID, std::vector<Osprey::Mesh> > _smallMeshes;
+        FlatMap<ON_UUID, Osprey::Curve> _curves;
+        FlatMap<ON__UINT32, FlattenedInstance> _flattened;
+        //! The flattened instances of each mesh.
+        FlatMap<ON_UUID, std::vector<ON__UINT32> > _flattenedByMesh;
+        FlatMap<BatchKey, Batch, BatchKeyHash> _batches;
+        FlatMap<ON_UUID, std::shared_ptr<PointCloudData> > _pointClouds;
+        size_t _pointBudget = 0;
+        float _pointFraction = 1.F;
+        bool _pointCloudsInit = true;
+        std::mutex _objectMutex;
+        FlatMap<ON_UUID, std::shared_ptr<ON_Curve> > _curveObjects;
+        FlatMap<ON_UUID, PointCloudChange> _pointCloudChanges;
+        FlatMap<ON_UUID, ObjectState> _objectStates;
+        std::unique_ptr<ObjectWatcher> _objectWatcher;
+        BVHPolicy _bvhPolicy = BVHPolicy::Automatic;
+        FlatMap<ON_UUID, EditHistory> _meshEdits;
+        EditHistory _instanceEdits;
+        std::chrono::steady_clock::duration _buildTime = std::chrono::steady_clock::duration::zero();
+        size_t _buildCount = 0;
         std::shared_ptr<ospray::cpp::Light>_sun;
         std::shared_ptr<ospray::cpp::Light> _ambient;
-        std::map<ON_UUID, ospray::cpp::Light> _lights;
+        FlatMap<ON_UUID, ospray::cpp::Light> _lights;
         bool _lightsInit = true;
+        CameraData _camera;
+        ON_UUID _viewportId = ON_nil_uuid;
+        FlatMap<ON_UUID, ClippingPlaneData> _clippingPlanes;
+        std::shared_ptr<ClippingData> _clipping;
+        bool _clippingChanged = false;
+        std::map<std::wstring, uint32_t> _contentHashes;
     };
 
 } // Osprey
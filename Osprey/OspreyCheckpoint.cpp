@@ -0,0 +1,337 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#include "stdafx.h"
+#include "OspreyCheckpoint.h"
+#include "OspreyUtil.h"
+
+namespace Osprey
+{
+    namespace
+    {
+        const char fileMagic[4] = { 'O', 'S', 'P', 'C' };
+        const uint32_t fileVersion = 2;
+        const uint32_t bucketMarker = 0x4b435542;
+
+        //! The number of floats per pixel of a bucket: the color (RGBA)
+        //! followed by the depth plane and the X, Y and Z normal planes.
+        const size_t pixelFloats = 8;
+
+        struct FileHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t sceneHash;
+            int32_t width;
+            int32_t height;
+            uint32_t passes;
+        };
+
+        struct BucketHeader
+        {
+            uint32_t marker;
+            int32_t x;
+            int32_t y;
+            int32_t w;
+            int32_t h;
+            uint32_t passes;
+            float variance;
+        };
+
+        std::wstring getFileName(uint32_t sceneHash)
+        {
+            wchar_t path[MAX_PATH];
+            if (0 == GetTempPathW(MAX_PATH, path))
+            {
+                path[0] = 0;
+            }
+            wchar_t name[32];
+            swprintf_s(name, L"Osprey_%08X.checkpoint", sceneHash);
+            return std::wstring(path) + name;
+        }
+
+        template<typename T>
+        uint32_t crc(uint32_t value, const T& data)
+        {
+            return ON_CRC32(value, sizeof(T), &data);
+        }
+
+    } // namespace
+
+    Checkpoint::Checkpoint()
+    {}
+
+    Checkpoint::~Checkpoint()
+    {
+        if (_f)
+        {
+            fclose(_f);
+        }
+    }
+
+    std::shared_ptr<Checkpoint> Checkpoint::create(
+        uint32_t sceneHash,
+        const ospcommon::math::vec2i& size,
+        size_t passes)
+    {
+        auto out = std::shared_ptr<Checkpoint>(new Checkpoint);
+        out->_fileName = getFileName(sceneHash);
+
+        FileHeader header;
+        memcpy(header.magic, fileMagic, sizeof(fileMagic));
+        header.version = fileVersion;
+        header.sceneHash = sceneHash;
+        header.width = size.x;
+        header.height = size.y;
+        header.passes = static_cast<uint32_t>(passes);
+
+        // Read the finished buckets from an existing file. A bucket that was
+        // only partly written when the render was interrupted is ignored and
+        // overwritten by the next bucket.
+        int64_t end = 0;
+        if (0 == _wfopen_s(&out->_f, out->_fileName.c_str(), L"r+b") && out->_f)
+        {
+            FileHeader fileHeader;
+            if (1 == fread(&fileHeader, sizeof(FileHeader), 1, out->_f) &&
+                0 == memcmp(&fileHeader, &header, sizeof(FileHeader)))
+            {
+                end = sizeof(FileHeader);
+                BucketHeader bucketHeader;
+                while (1 == fread(&bucketHeader, sizeof(BucketHeader), 1, out->_f) &&
+                    bucketMarker == bucketHeader.marker &&
+                    bucketHeader.w > 0 &&
+                    bucketHeader.h > 0)
+                {
+                    const int64_t dataSize = static_cast<int64_t>(bucketHeader.w) * bucketHeader.h * pixelFloats * sizeof(float);
+                    if (_fseeki64(out->_f, 0, SEEK_END) != 0 ||
+                        _ftelli64(out->_f) < end + static_cast<int64_t>(sizeof(BucketHeader)) + dataSize)
+                        break;
+                    Bucket bucket;
+                    bucket.rect = ospcommon::math::box2i(
+                        ospcommon::math::vec2i(bucketHeader.x, bucketHeader.y),
+                        ospcommon::math::vec2i(bucketHeader.x + bucketHeader.w, bucketHeader.y + bucketHeader.h));
+                    bucket.passes = bucketHeader.passes;
+                    bucket.variance = bucketHeader.variance;
+                    bucket.offset = end + sizeof(BucketHeader);
+                    out->_buckets.push_back(bucket);
+                    end = bucket.offset + dataSize;
+                    _fseeki64(out->_f, end, SEEK_SET);
+                }
+            }
+            if (0 == end)
+            {
+                fclose(out->_f);
+                out->_f = nullptr;
+            }
+        }
+
+        // Start a new file.
+        if (!out->_f)
+        {
+            if (_wfopen_s(&out->_f, out->_fileName.c_str(), L"w+b") != 0 || !out->_f)
+            {
+                out->_f = nullptr;
+                printError("Cannot open the checkpoint file");
+                return nullptr;
+            }
+            fwrite(&header, sizeof(FileHeader), 1, out->_f);
+            end = sizeof(FileHeader);
+        }
+        _fseeki64(out->_f, end, SEEK_SET);
+
+        return out;
+    }
+
+    size_t Checkpoint::getFinishedCount() const
+    {
+        return _buckets.size();
+    }
+
+    bool Checkpoint::isFinished(const ospcommon::math::box2i& rect) const
+    {
+        for (const auto& i : _buckets)
+        {
+            if (i.rect.lower == rect.lower && i.rect.upper == rect.upper)
+                return true;
+        }
+        return false;
+    }
+
+    void Checkpoint::restore(IRhRdkRenderWindow& rdkRenderWindow)
+    {
+        if (_buckets.empty())
+            return;
+        IRhRdkRenderWindow::IChannel* pChanRGBA = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanRGBA);
+        if (!pChanRGBA)
+            return;
+        IRhRdkRenderWindow::IChannel* aovChannels[] =
+        {
+            rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanDistanceFromCamera),
+            rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanNormalX),
+            rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanNormalY),
+            rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanNormalZ)
+        };
+        const int64_t end = _ftelli64(_f);
+        for (const auto& i : _buckets)
+        {
+            const ospcommon::math::vec2i size = i.rect.size();
+            const size_t planeSize = static_cast<size_t>(size.x) * size.y;
+            _temp.resize(planeSize * pixelFloats);
+            if (0 == _fseeki64(_f, i.offset, SEEK_SET) &&
+                _temp.size() == fread(_temp.data(), sizeof(float), _temp.size(), _f))
+            {
+                pChanRGBA->SetValueRect(
+                    i.rect.lower.x,
+                    i.rect.lower.y,
+                    size.x,
+                    size.y,
+                    size.x * 4 * sizeof(float),
+                    ComponentOrder::RGBA,
+                    _temp.data());
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    if (aovChannels[j])
+                    {
+                        aovChannels[j]->SetValueRect(
+                            i.rect.lower.x,
+                            i.rect.lower.y,
+                            size.x,
+                            size.y,
+                            size.x * sizeof(float),
+                            ComponentOrder::Irrelevant,
+                            _temp.data() + planeSize * (4 + j));
+                    }
+                }
+            }
+        }
+        pChanRGBA->Close();
+        for (auto i : aovChannels)
+        {
+            if (i)
+            {
+                i->Close();
+            }
+        }
+        rdkRenderWindow.Invalidate();
+        _fseeki64(_f, end, SEEK_SET);
+    }
+
+    void Checkpoint::add(
+        const ospcommon::math::box2i& rect,
+        const float* color,
+        const float* depth,
+        const float* normals,
+        size_t passes,
+        float variance,
+        bool flipY)
+    {
+        const ospcommon::math::vec2i size = rect.size();
+        BucketHeader header;
+        header.marker = bucketMarker;
+        header.x = rect.lower.x;
+        header.y = rect.lower.y;
+        header.w = size.x;
+        header.h = size.y;
+        header.passes = static_cast<uint32_t>(passes);
+        header.variance = variance;
+
+        Bucket bucket;
+        bucket.rect = rect;
+        bucket.passes = header.passes;
+        bucket.variance = variance;
+        bucket.offset = _ftelli64(_f) + sizeof(BucketHeader);
+
+        bool ok = 1 == fwrite(&header, sizeof(BucketHeader), 1, _f);
+        const size_t rowSize = static_cast<size_t>(size.x);
+        for (int y = 0; y < size.y && ok; ++y)
+        {
+            const float* row = color + (flipY ? size.y - 1 - y : y) * rowSize * 4;
+            ok = rowSize * 4 == fwrite(row, sizeof(float), rowSize * 4, _f);
+        }
+        for (int y = 0; y < size.y && ok; ++y)
+        {
+            const float* row = depth + (flipY ? size.y - 1 - y : y) * rowSize;
+            ok = rowSize == fwrite(row, sizeof(float), rowSize, _f);
+        }
+
+        // The normals are written as one plane per channel, the same as the
+        // render window channels.
+        _temp.resize(rowSize);
+        for (size_t c = 0; c < 3 && ok; ++c)
+        {
+            for (int y = 0; y < size.y && ok; ++y)
+            {
+                const float* row = normals + (flipY ? size.y - 1 - y : y) * rowSize * 3;
+                for (size_t x = 0; x < rowSize; ++x)
+                {
+                    _temp[x] = row[x * 3 + c];
+                }
+                ok = rowSize == fwrite(_temp.data(), sizeof(float), rowSize, _f);
+            }
+        }
+        if (ok && 0 == fflush(_f))
+        {
+            _buckets.push_back(bucket);
+        }
+        else
+        {
+            printError("Cannot write the checkpoint file");
+        }
+    }
+
+    void Checkpoint::remove()
+    {
+        if (_f)
+        {
+            fclose(_f);
+            _f = nullptr;
+            _wremove(_fileName.c_str());
+        }
+        _buckets.clear();
+    }
+
+    uint32_t Checkpoint::getSceneHash(
+        const CRhinoDoc& rhinoDoc,
+        const ON_3dmView& view,
+        const Options& options,
+        const ospcommon::math::vec2i& renderSize,
+        const ospcommon::math::box2i& renderRect,
+        uint32_t contentHash)
+    {
+        uint32_t out = 0;
+
+        // The objects are hashed by their IDs and the CRC of their data,
+        // which are the same between sessions.
+        CRhinoObjectIterator it(rhinoDoc, CRhinoObjectIterator::normal_or_locked_objects, CRhinoObjectIterator::active_and_reference_objects);
+        for (const CRhinoObject* object = it.First(); object; object = it.Next())
+        {
+            out = crc(out, object->Attributes().m_uuid);
+            out = object->Geometry() ? object->Geometry()->DataCRC(out) : out;
+            out = object->Attributes().DataCRC(out);
+        }
+
+        // The materials, environment, and lighting are hashed by the change
+        // queue as they are applied.
+        out = crc(out, contentHash);
+
+        out = crc(out, view.m_vp.CameraLocation());
+        out = crc(out, view.m_vp.CameraDirection());
+        out = crc(out, view.m_vp.CameraUp());
+        double frustum[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+        view.m_vp.GetFrustum(&frustum[0], &frustum[1], &frustum[2], &frustum[3], &frustum[4], &frustum[5]);
+        out = ON_CRC32(out, sizeof(frustum), frustum);
+
+        out = ON_CRC32(out, options.rendererName.size(), options.rendererName.c_str());
+        out = crc(out, options.passes);
+        out = crc(out, options.pixelSamples);
+        out = crc(out, options.aoSamples);
+        out = crc(out, options.denoiserFound && options.denoiserEnabled);
+        out = crc(out, options.toneMapperEnabled);
+        out = crc(out, options.toneMapperExposure);
+        out = crc(out, options.bucketSize);
+        out = crc(out, renderSize);
+        out = crc(out, renderRect);
+        return out;
+    }
+
+} // namespace Osprey
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#pragma once
+
+#include "OspreyData.h"
+
+namespace Osprey
+{
+    //! This class saves the finished buckets of a final render to a file, so
+    //! that an interrupted render can be resumed from the last finished
+    //! bucket. The file is named by a hash of the scene and render settings,
+    //! so a checkpoint is only used for the same scene.
+    //!
+    //! Each bucket stores the display color, the depth, the normals, the
+    //! number of passes and the variance. The buckets are appended to the
+    //! file as they finish.
+    class Checkpoint
+    {
+        Checkpoint();
+        Checkpoint(const Checkpoint&) = delete;
+        Checkpoint& operator = (const Checkpoint&) = delete;
+
+    public:
+        ~Checkpoint();
+
+        // Create a new instance. The finished buckets are read from an
+        // existing checkpoint file for the scene, otherwise a new file is
+        // started. Returns nullptr if the file cannot be opened.
+        static std::shared_ptr<Checkpoint> create(
+            uint32_t sceneHash,
+            const ospcommon::math::vec2i& size,
+            size_t passes);
+
+        //! Get the number of finished buckets.
+        size_t getFinishedCount() const;
+
+        //! Get whether a bucket is finished. The rectangle is in window
+        //! coordinates.
+        bool isFinished(const ospcommon::math::box2i&) const;
+
+        //! Copy the finished buckets to the color, depth and normal channels of
+        //! the render window.
+        void restore(IRhRdkRenderWindow&);
+
+        //! Add a finished bucket. The rectangle is in window coordinates, and
+        //! the color (RGBA), depth and normal (XYZ) rows are ordered from
+        //! bottom to top if flipY is true.
+        void add(
+            const ospcommon::math::box2i&,
+            const float* color,
+            const float* depth,
+            const float* normals,
+            size_t passes,
+            float variance,
+            bool flipY);
+
+        //! Remove the checkpoint file once the render has finished.
+        void remove();
+
+        //! Get a hash of the scene and the settings that change the image.
+        static uint32_t getSceneHash(
+            const CRhinoDoc&,
+            const ON_3dmView&,
+            const Options&,
+            const ospcommon::math::vec2i& renderSize,
+            const ospcommon::math::box2i& renderRect,
+            uint32_t contentHash);
+
+    private:
+        struct Bucket
+        {
+            ospcommon::math::box2i rect;
+            uint32_t passes = 0;
+            float variance = 0.F;
+            int64_t offset = 0;
+        };
+
+        std::wstring _fileName;
+        FILE* _f = nullptr;
+        std::vector<Bucket> _buckets;
+        std::vector<float> _temp;
+    };
+
+} // namespace Osprey
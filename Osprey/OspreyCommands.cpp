@@ -0,0 +1,425 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#include "stdafx.h"
+#include "OspreyCameraPath.h"
+#include "OspreyPlugIn.h"
+#include "OspreyQuietRender.h"
+#include "OspreySelfTest.h"
+#include "OspreyUtil.h"
+
+namespace
+{
+    //! Find a named view of a document, the comparison ignores case.
+    bool findNamedView(const CRhinoDoc& rhinoDoc, const wchar_t* name, ON_3dmView& out)
+    {
+        const auto& namedViews = rhinoDoc.NamedViewTable();
+        for (int i = 0; i < namedViews.Count(); ++i)
+        {
+            if (0 == namedViews[i].m_name.CompareNoCase(name))
+            {
+                out = namedViews[i];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! Get the name of the image file to save.
+    bool getImageFileName(const CRhinoCommandContext& context, ON_wString& out)
+    {
+        CRhinoGetFileDialog getFileName;
+        getFileName.SetScriptMode(context.IsInteractive() ? FALSE : TRUE);
+        if (!getFileName.DisplayFileDialog(CRhinoGetFileDialog::save_bitmap_dialog, nullptr, CWnd::FromHandle(RhinoApp().MainWnd())))
+            return false;
+        out = getFileName.FileName();
+        out.TrimLeftAndRight();
+        return !out.IsEmpty();
+    }
+
+    //! Replace the characters that are not allowed in file names.
+    std::wstring getSafeFileName(const wchar_t* value)
+    {
+        std::wstring out = value;
+        for (auto& c : out)
+        {
+            if (wcschr(L"\\/:*?\"<>|", c))
+            {
+                c = L'_';
+            }
+        }
+        return out;
+    }
+
+    //! Add a suffix to a file name before the extension, for example
+    //! "render.png" with the suffix "Front" becomes "render_Front.png".
+    std::wstring addFileNameSuffix(const std::wstring& fileName, const std::wstring& suffix)
+    {
+        const size_t slash = fileName.find_last_of(L"\\/");
+        const size_t dot = fileName.rfind(L'.');
+        const size_t split = dot != std::wstring::npos && (slash == std::wstring::npos || dot > slash) ? dot : fileName.size();
+        return fileName.substr(0, split) + L"_" + suffix + fileName.substr(split);
+    }
+
+    //! Check whether the escape key is down while Rhino is the active
+    //! application. The key state is polled so that no messages are
+    //! dispatched while rendering.
+    bool isEscapePressed()
+    {
+        return ::GetForegroundWindow() == RhinoApp().MainWnd() &&
+            (::GetAsyncKeyState(VK_ESCAPE) & 0x8000) != 0;
+    }
+
+    struct SequenceItem
+    {
+        ON_3dmView view;
+        ON_2iSize size;
+        std::wstring fileName;
+    };
+
+    //! Render a sequence of views with the quiet render. The scene is built
+    //! once and only the camera changes between views, and each image is
+    //! saved in the background while the next one renders. Pressing escape
+    //! cancels the render and the rest of the sequence. Returns failure if
+    //! any of the images could not be rendered or saved.
+    //!
+    //! The frames are not submitted to OSPRay ahead of time: they share the
+    //! resident world and the frame buffers, so the next camera can only be
+    //! set when the current frame has finished. Each pass is still rendered
+    //! through an ospRenderFrame() future, and saving is what overlaps with
+    //! rendering.
+    CRhinoCommand::result renderSequence(const CRhinoDoc& rhinoDoc, const std::vector<SequenceItem>& items)
+    {
+        const auto sequenceStart = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::duration renderTime = std::chrono::steady_clock::duration::zero();
+        auto& plugIn = ::OspreyPlugIn();
+        std::shared_ptr<Osprey::QuietRender> quietRender;
+        std::wstring saveFileName;
+        size_t rendered = 0;
+        size_t failed = 0;
+        bool cancelled = false;
+        const auto progress = [&cancelled](float)
+        {
+            cancelled = isEscapePressed();
+            return !cancelled;
+        };
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            const auto& item = items[i];
+
+            // Render the view while the previous image is being saved.
+            const auto renderStart = std::chrono::steady_clock::now();
+            const bool ok =
+                progress(0.F) &&
+                plugIn.RenderQuietView(rhinoDoc, item.view, item.size, item.fileName.c_str(), progress);
+            const auto time = std::chrono::steady_clock::now() - renderStart;
+            renderTime += time;
+
+            // Check the previous save before starting the next one.
+            if (quietRender && !saveFileName.empty() && !quietRender->waitSave())
+            {
+                RhinoApp().Print(L"Cannot save \"%ls\".\n", saveFileName.c_str());
+                ++failed;
+            }
+            saveFileName.clear();
+
+            if (cancelled)
+            {
+                RhinoApp().Print(L"Sequence cancelled at \"%ls\".\n", item.fileName.c_str());
+                break;
+            }
+            if (!ok)
+            {
+                RhinoApp().Print(L"Cannot render \"%ls\".\n", item.fileName.c_str());
+                ++failed;
+                continue;
+            }
+            quietRender = plugIn.GetQuietRender();
+            quietRender->saveAsync(item.fileName);
+            saveFileName = item.fileName;
+            ++rendered;
+
+            std::stringstream ss;
+            ss << "Image " << (i + 1) << " of " << items.size() << ": " <<
+                std::chrono::duration_cast<std::chrono::milliseconds>(time).count() << " ms";
+            Osprey::printMessage(ss.str());
+        }
+        if (quietRender && !saveFileName.empty() && !quietRender->waitSave())
+        {
+            RhinoApp().Print(L"Cannot save \"%ls\".\n", saveFileName.c_str());
+            ++failed;
+        }
+
+        std::stringstream ss;
+        ss << "Sequence: " << rendered << " images, render " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(renderTime).count() << " ms, total " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sequenceStart).count() << " ms";
+        Osprey::printMessage(ss.str());
+
+        if (cancelled)
+            return CRhinoCommand::cancel;
+        return 0 == failed ? CRhinoCommand::success : CRhinoCommand::failure;
+    }
+
+} // namespace
+
+//! This command renders the active view or a named view without any user
+//! interface and saves the image, so that it can be used from scripts.
+class COspreyRenderQuietCommand : public CRhinoCommand
+{
+public:
+    UUID CommandUUID() override
+    {
+        // {C0075B1A-71A7-4111-8C65-60C0BEB69790}
+        static const GUID uuid =
+        {
+            0xc0075b1a,
+            0x71a7,
+            0x4111,
+            { 0x8c, 0x65, 0x60, 0xc0, 0xbe, 0xb6, 0x97, 0x90 }
+        };
+        return uuid;
+    }
+
+    const wchar_t* EnglishCommandName() override
+    {
+        return L"OspreyRenderQuiet";
+    }
+
+    CRhinoCommand::result RunCommand(const CRhinoCommandContext&) override;
+};
+
+static class COspreyRenderQuietCommand theOspreyRenderQuietCommand;
+
+CRhinoCommand::result COspreyRenderQuietCommand::RunCommand(const CRhinoCommandContext& context)
+{
+    const auto rhinoDoc = context.Document();
+    const auto rhinoView = RhinoApp().ActiveView();
+    if (nullptr == rhinoDoc || nullptr == rhinoView)
+        return CRhinoCommand::failure;
+
+    // Get the view, pressing Enter renders the active view.
+    ON_3dmView view = rhinoView->ActiveViewport().View();
+    CRhinoGetString getViewName;
+    getViewName.SetCommandPrompt(L"Named view to render <Active view>");
+    getViewName.AcceptNothing(TRUE);
+    switch (getViewName.GetString())
+    {
+    case CRhinoGet::nothing: break;
+    case CRhinoGet::string:
+        if (!findNamedView(*rhinoDoc, getViewName.String(), view))
+        {
+            RhinoApp().Print(L"Named view \"%ls\" not found.\n", static_cast<const wchar_t*>(getViewName.String()));
+            return CRhinoCommand::failure;
+        }
+        break;
+    default: return CRhinoCommand::cancel;
+    }
+
+    // Get the file name.
+    ON_wString fileName;
+    if (!getImageFileName(context, fileName))
+        return CRhinoCommand::cancel;
+
+    auto& plugIn = ::OspreyPlugIn();
+    if (!plugIn.RenderQuietView(*rhinoDoc, view, Osprey::QuietRender::getRenderSize(*rhinoDoc, view), fileName))
+        return CRhinoCommand::failure;
+    if (!plugIn.SaveRenderedImage(fileName))
+    {
+        RhinoApp().Print(L"Cannot save \"%ls\".\n", static_cast<const wchar_t*>(fileName));
+        return CRhinoCommand::failure;
+    }
+
+    return CRhinoCommand::success;
+}
+
+//! This command renders all of the named views of a document. The scene is
+//! built once and only the camera changes between views, and each image is
+//! saved in the background while the next view renders.
+class COspreyRenderNamedViewsCommand : public CRhinoCommand
+{
+public:
+    UUID CommandUUID() override
+    {
+        // {4F0A9B6E-2D31-4C8E-9A57-B3E1C6D2F804}
+        static const GUID uuid =
+        {
+            0x4f0a9b6e,
+            0x2d31,
+            0x4c8e,
+            { 0x9a, 0x57, 0xb3, 0xe1, 0xc6, 0xd2, 0xf8, 0x04 }
+        };
+        return uuid;
+    }
+
+    const wchar_t* EnglishCommandName() override
+    {
+        return L"OspreyRenderNamedViews";
+    }
+
+    CRhinoCommand::result RunCommand(const CRhinoCommandContext&) override;
+};
+
+static class COspreyRenderNamedViewsCommand theOspreyRenderNamedViewsCommand;
+
+CRhinoCommand::result COspreyRenderNamedViewsCommand::RunCommand(const CRhinoCommandContext& context)
+{
+    const auto rhinoDoc = context.Document();
+    if (nullptr == rhinoDoc)
+        return CRhinoCommand::failure;
+
+    const auto& namedViews = rhinoDoc->NamedViewTable();
+    if (0 == namedViews.Count())
+    {
+        RhinoApp().Print(L"No named views.\n");
+        return CRhinoCommand::nothing;
+    }
+
+    // Get the base file name, the view names are added to it.
+    ON_wString baseFileName;
+    if (!getImageFileName(context, baseFileName))
+        return CRhinoCommand::cancel;
+
+    std::vector<SequenceItem> items;
+    for (int i = 0; i < namedViews.Count(); ++i)
+    {
+        SequenceItem item;
+        item.view = namedViews[i];
+        item.size = Osprey::QuietRender::getRenderSize(*rhinoDoc, item.view);
+        item.fileName = addFileNameSuffix(static_cast<const wchar_t*>(baseFileName), getSafeFileName(item.view.m_name));
+        items.push_back(item);
+    }
+    return renderSequence(*rhinoDoc, items);
+}
+
+//! This command renders a camera animation, either an orbit around the
+//! target of the active view or a path through the named views. The frames
+//! are rendered back to back with the same scene and frame buffers, and
+//! each frame is saved while the next one renders.
+class COspreyRenderAnimationCommand : public CRhinoCommand
+{
+public:
+    UUID CommandUUID() override
+    {
+        // {9B3C27D5-6E48-4F1A-8D0C-5A72E94B1C36}
+        static const GUID uuid =
+        {
+            0x9b3c27d5,
+            0x6e48,
+            0x4f1a,
+            { 0x8d, 0x0c, 0x5a, 0x72, 0xe9, 0x4b, 0x1c, 0x36 }
+        };
+        return uuid;
+    }
+
+    const wchar_t* EnglishCommandName() override
+    {
+        return L"OspreyRenderAnimation";
+    }
+
+    CRhinoCommand::result RunCommand(const CRhinoCommandContext&) override;
+
+private:
+    int _path = 0;
+    int _frames = 36;
+};
+
+static class COspreyRenderAnimationCommand theOspreyRenderAnimationCommand;
+
+CRhinoCommand::result COspreyRenderAnimationCommand::RunCommand(const CRhinoCommandContext& context)
+{
+    const auto rhinoDoc = context.Document();
+    const auto rhinoView = RhinoApp().ActiveView();
+    if (nullptr == rhinoDoc || nullptr == rhinoView)
+        return CRhinoCommand::failure;
+
+    // Get the options. For the orbit the number of frames is the length of
+    // the animation, for the named views it is the number of frames between
+    // each view.
+    const CRhinoCommandOptionValue paths[] = { RHCMDOPTVALUE(L"Orbit"), RHCMDOPTVALUE(L"NamedViews") };
+    CRhinoGetOption getOption;
+    getOption.SetCommandPrompt(L"Animation options");
+    getOption.AcceptNothing(TRUE);
+    while (true)
+    {
+        getOption.ClearCommandOptions();
+        const int pathOption = getOption.AddCommandOptionList(RHCMDOPTNAME(L"Path"), 2, paths, _path);
+        getOption.AddCommandOptionInteger(RHCMDOPTNAME(L"Frames"), &_frames, L"Number of frames", 1, 100000);
+        const CRhinoGet::result result = getOption.GetOption();
+        if (CRhinoGet::nothing == result)
+            break;
+        if (CRhinoGet::option != result)
+            return CRhinoCommand::cancel;
+        const CRhinoCommandOption* option = getOption.Option();
+        if (option && option->m_option_index == pathOption)
+        {
+            _path = option->m_list_option_current;
+        }
+    }
+
+    const ON_3dmView& activeView = rhinoView->ActiveViewport().View();
+    const std::vector<ON_3dmView> views = 0 == _path ?
+        Osprey::getOrbitPath(activeView, static_cast<size_t>(_frames)) :
+        Osprey::getNamedViewPath(*rhinoDoc, static_cast<size_t>(_frames));
+    if (views.empty())
+    {
+        RhinoApp().Print(L"No named views.\n");
+        return CRhinoCommand::nothing;
+    }
+
+    // Get the base file name, the frame numbers are added to it.
+    ON_wString baseFileName;
+    if (!getImageFileName(context, baseFileName))
+        return CRhinoCommand::cancel;
+
+    // All of the frames are the same size so the frame buffers are kept.
+    const ON_2iSize size = Osprey::QuietRender::getRenderSize(*rhinoDoc, views[0]);
+    std::vector<SequenceItem> items;
+    for (size_t i = 0; i < views.size(); ++i)
+    {
+        SequenceItem item;
+        item.view = views[i];
+        item.size = size;
+        wchar_t frame[16];
+        swprintf_s(frame, L"%04d", static_cast<int>(i));
+        item.fileName = addFileNameSuffix(static_cast<const wchar_t*>(baseFileName), frame);
+        items.push_back(item);
+    }
+    return renderSequence(*rhinoDoc, items);
+}
+
+//! This command checks the flat map and the batched transform conversion
+//! against their reference implementations, and prints the time of the
+//! transform conversion.
+class COspreySelfTestCommand : public CRhinoCommand
+{
+public:
+    UUID CommandUUID() override
+    {
+        // {AD3BB3B4-C40E-4503-AFC9-D87E2017717A}
+        static const GUID uuid =
+        {
+            0xad3bb3b4,
+            0xc40e,
+            0x4503,
+            { 0xaf, 0xc9, 0xd8, 0x7e, 0x20, 0x17, 0x71, 0x7a }
+        };
+        return uuid;
+    }
+
+    const wchar_t* EnglishCommandName() override
+    {
+        return L"OspreySelfTest";
+    }
+
+    CRhinoCommand::result RunCommand(const CRhinoCommandContext&) override;
+};
+
+static class COspreySelfTestCommand theOspreySelfTestCommand;
+
+CRhinoCommand::result COspreySelfTestCommand::RunCommand(const CRhinoCommandContext&)
+{
+    bool ok = Osprey::testFlatMap();
+    ok &= Osprey::testTransforms();
+    return ok ? CRhinoCommand::success : CRhinoCommand::failure;
+}
@@ -6,4 +6,46 @@
 
 namespace Osprey
 {
+    bool Options::operator == (const Options& other) const
+    {
+        return
+            rendererName == other.rendererName &&
+            supportsMaterials == other.supportsMaterials &&
+            previewPasses == other.previewPasses &&
+            passes == other.passes &&
+            pixelSamples == other.pixelSamples &&
+            aoSamples == other.aoSamples &&
+            denoiserFound == other.denoiserFound &&
+            denoiserEnabled == other.denoiserEnabled &&
+            denoiserInterval == other.denoiserInterval &&
+            denoisePreviews == other.denoisePreviews &&
+            toneMapperEnabled == other.toneMapperEnabled &&
+            toneMapperExposure == other.toneMapperExposure &&
+            flattenMeshes == other.flattenMeshes &&
+            bvhPolicy == other.bvhPolicy &&
+            bucketSize == other.bucketSize &&
+            pointBudget == other.pointBudget &&
+            checkpoints == other.checkpoints &&
+            flipY == other.flipY;
+    }
+
+    bool Options::operator != (const Options& other) const
+    {
+        return !(*this == other);
+    }
+
+    bool DeviceOptions::operator == (const DeviceOptions& other) const
+    {
+        return
+            device == other.device &&
+            threadCount == other.threadCount &&
+            reservedCores == other.reservedCores &&
+            threadAffinity == other.threadAffinity;
+    }
+
+    bool DeviceOptions::operator != (const DeviceOptions& other) const
+    {
+        return !(*this == other);
+    }
+
 } // namespace Osprey
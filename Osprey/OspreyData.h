@@ -17,18 +17,67 @@ namespace Osprey
         size_t aoSamples = 1;
         bool denoiserFound = false;
         bool denoiserEnabled = true;
+        DenoiserInterval denoiserInterval = DenoiserInterval::EveryPass;
+        bool denoisePreviews = false;
         bool toneMapperEnabled = false;
         float toneMapperExposure = 1.F;
+        bool flattenMeshes = false;
+        BVHPolicy bvhPolicy = BVHPolicy::Automatic;
+        BucketSize bucketSize = BucketSize::Automatic;
+        PointBudget pointBudget = PointBudget::_5M;
+        bool checkpoints = false;
         bool flipY = false;
+
+        bool operator == (const Options&) const;
+        bool operator != (const Options&) const;
+    };
+
+    //! The options for the OSPRay device. These are applied when the device
+    //! is initialized.
+    struct DeviceOptions
+    {
+        Device device = Device::Local;
+        ThreadCount threadCount = ThreadCount::Automatic;
+        ReservedCores reservedCores = ReservedCores::_0;
+        bool threadAffinity = false;
+
+        bool operator == (const DeviceOptions&) const;
+        bool operator != (const DeviceOptions&) const;
+    };
+
+    struct Mesh
+    {
+        ON_UUID id;
+        std::vector<ospcommon::math::vec3f> v;
+        std::vector<ospcommon::math::vec3f> n;
+        std::vector<ospcommon::math::vec2f> t;
+        std::vector<ospcommon::math::vec4f> c;
+        std::vector<ospcommon::math::vec3ui> i;
+    };
+
+    //! Curves are converted to linear segments with a radius for each
+    //! vertex. The indices are the first vertex of each segment.
+    struct Curve
+    {
+        std::vector<ospcommon::math::vec4f> v;
+        std::vector<uint32_t> i;
     };
 
     struct Update
     {
         bool update = false;
+        bool options = false;
         std::condition_variable cv;
         std::mutex mutex;
     };
 
+    //! This struct provides the 8-bit image that is drawn in the viewport.
+    struct ViewportImage
+    {
+        CRhinoDib dib;
+        std::mutex mutex;
+    };
+
     struct Background
     {
         BackgroundType type;
@@ -43,6 +92,12 @@ namespace Osprey
         ospray::cpp::Camera camera;
         ospcommon::math::vec2i renderSize = { 0, 0 };
         ospcommon::math::box2i renderRect = { { 0, 0 }, { 0, 0 } };
+        //! The position of the render rectangle within the render window.
+        ospcommon::math::vec2i windowOffset = { 0, 0 };
+        //! The gamma of the document linear workflow, which is applied when
+        //! the image is converted to 8-bit. Rhino applies it for the render
+        //! window.
+        float gamma = 2.2F;
     };
 
 } // namespace Osprey
@@ -4,6 +4,8 @@
 #include "stdafx.h"
 #include "OspreyChangeQueue.h"
 #include "OspreyDisplayMode.h"
+#include "OspreyLog.h"
+#include "OspreyPlugIn.h"
 #include "OspreyRender.h"
 #include "OspreySettings.h"
 #include "OspreyUtil.h"
@@ -22,109 +24,22 @@ namespace Osprey
 		RhRdk::Realtime::DisplayMode(pipeline)
 	{
         _update = std::make_shared<Update>();
+        _viewportImage = std::make_shared<ViewportImage>();
 
         _scene = std::make_shared<Scene>();
         _scene->world = ospray::cpp::World();
-        //_scene->world.setParam("dynamicScene", int(RTC_SCENE_FLAG_DYNAMIC));
         _renderRunning = false;
 
-        // Listen for settings changes.
-        _rendererObserver = ValueObserver<Renderer>::create(
-            settings->observeRenderer(),
-            [this](Renderer value)
+        // Listen for settings changes. The options are observed as a whole
+        // so that settings which don't affect rendering don't restart it.
+        _optionsObserver = ValueObserver<Options>::create(
+            settings->observeOptions(),
+            [this](const Options& value)
         {
             {
                 std::lock_guard<std::mutex> lock(_update->mutex);
-                _update->update = true;
-                _options.rendererName = getRendererValue(value);
-            }
-            _update->cv.notify_one();
-        });
-        _passesObserver = ValueObserver<Passes>::create(
-            settings->observePasses(),
-            [this](Passes value)
-        {
-            {
-                std::lock_guard<std::mutex> lock(_update->mutex);
-                _update->update = true;
-                _options.passes = getPassesValue(value);
-            }
-            _update->cv.notify_one();
-        });
-        _previewPassesObserver = ValueObserver<PreviewPasses>::create(
-            settings->observePreviewPasses(),
-            [this](PreviewPasses value)
-        {
-            {
-                std::lock_guard<std::mutex> lock(_update->mutex);
-                _update->update = true;
-                _options.previewPasses = getPreviewPassesValue(value);
-            }
-            _update->cv.notify_one();
-        });
-        _pixelSamplesObserver = ValueObserver<PixelSamples>::create(
-            settings->observePixelSamples(),
-            [this](PixelSamples value)
-        {
-            {
-                std::lock_guard<std::mutex> lock(_update->mutex);
-                _update->update = true;
-                _options.pixelSamples = getPixelSamplesValue(value);
-            }
-            _update->cv.notify_one();
-        });
-        _aoSamplesObserver = ValueObserver<AOSamples>::create(
-            settings->observeAOSamples(),
-            [this](AOSamples value)
-        {
-            {
-                std::lock_guard<std::mutex> lock(_update->mutex);
-                _update->update = true;
-                _options.aoSamples = getAOSamplesValue(value);
-            }
-            _update->cv.notify_one();
-        });
-        _denoiserFoundObserver = ValueObserver<bool>::create(
-            settings->observeDenoiserFound(),
-            [this](bool value)
-        {
-            {
-                std::lock_guard<std::mutex> lock(_update->mutex);
-                _update->update = true;
-                _options.denoiserFound = value;
-            }
-            _update->cv.notify_one();
-        });
-        _denoiserEnabledObserver = ValueObserver<bool>::create(
-            settings->observeDenoiserEnabled(),
-            [this](bool value)
-        {
-            {
-                std::lock_guard<std::mutex> lock(_update->mutex);
-                _update->update = true;
-                _options.denoiserEnabled = value;
-            }
-            _update->cv.notify_one();
-        });
-        _toneMapperEnabledObserver = ValueObserver<bool>::create(
-            settings->observeToneMapperEnabled(),
-            [this](bool value)
-        {
-            {
-                std::lock_guard<std::mutex> lock(_update->mutex);
-                _update->update = true;
-                _options.toneMapperEnabled = value;
-            }
-            _update->cv.notify_one();
-        });
-        _toneMapperExposureObserver = ValueObserver<Exposure>::create(
-            settings->observeToneMapperExposure(),
-            [this](Exposure value)
-        {
-            {
-                std::lock_guard<std::mutex> lock(_update->mutex);
-                _update->update = true;
-                _options.toneMapperExposure = getExposureValue(value);
+                _update->options = true;
+                _options = value;
             }
             _update->cv.notify_one();
         });
@@ -159,20 +74,23 @@ namespace Osprey
 		_rdkRenderWindow.reset(IRhRdkRenderWindow::New());
 		if (!_rdkRenderWindow)
 			return false;
+		// The render window only provides the size, the image is drawn from
+		// the viewport image so the render window DIB is not needed.
 		_rdkRenderWindow->SetSize(onSize);
-		if (!_rdkRenderWindow->EnsureDib())
-		{
-			_rdkRenderWindow.reset();
+		if (!_createViewportImage(onSize))
 			return false;
-		}
 
         // Create the change queue.
         _changeQueue = std::shared_ptr<ChangeQueue>(new ChangeQueue(rhinoDoc, onView, _update, _scene));
         _changeQueue->setRendererName(_options.rendererName, _options.supportsMaterials);
+        _changeQueue->setFlattenMeshes(_options.flattenMeshes);
+        _changeQueue->setBVHPolicy(_options.bvhPolicy);
+        _changeQueue->setPointBudget(getPointBudgetValue(_options.pointBudget));
         _changeQueue->CreateWorld();
 
         // Create the renderer.
 		_render = Render::create();
+		_render->setViewportImage(_viewportImage);
         _startRenderer();
 
 		return true;
@@ -187,11 +105,8 @@ namespace Osprey
         }
         
         _rdkRenderWindow->SetSize(onSize);
-		if (!_rdkRenderWindow->EnsureDib())
-		{
-			_rdkRenderWindow.reset();
+		if (!_createViewportImage(onSize))
 			return false;
-		}
 
         _update->update = true;
         _scene->renderSize = fromRhino(_rdkRenderWindow->Size());
@@ -260,12 +175,16 @@ namespace Osprey
 		const FRAME_BUFFER_INFO_INPUTS& input,
 		FRAME_BUFFER_INFO_OUTPUTS& outputs)
 	{
+		// Print the messages from the render thread.
+		drainLog();
+
+		// The viewport image is drawn instead of the render window DIB, it
+		// is locked until the pipeline has drawn it.
 		if (!outputs.client_render_success)
 		{
-			const CRhinoDib* pDib = _rdkRenderWindow->LockDib();
-			if (!pDib)
-				return false;
-			outputs.pointer_to_dib = pDib;
+			_viewportImage->mutex.lock();
+			_viewportImageLocked = true;
+			outputs.pointer_to_dib = &_viewportImage->dib;
             outputs.flip_y = true;
 		}
 		return true;
@@ -273,7 +192,11 @@ namespace Osprey
 
 	void DisplayMode::UnlockRendererFrameBuffer()
 	{
-		_rdkRenderWindow->UnlockDib();
+		if (_viewportImageLocked)
+		{
+			_viewportImageLocked = false;
+			_viewportImage->mutex.unlock();
+		}
 	}
 
 	bool DisplayMode::UseFastDraw()
@@ -281,6 +204,12 @@ namespace Osprey
 		return false;
 	}
 
+	bool DisplayMode::_createViewportImage(const ON_2iSize& onSize)
+	{
+		std::lock_guard<std::mutex> lock(_viewportImage->mutex);
+		return _viewportImage->dib.CreateDib(onSize.cx, onSize.cy, 32, true);
+	}
+
 	void DisplayMode::_startRenderer()
 	{
         _renderRunning = true;
@@ -291,11 +220,12 @@ namespace Osprey
                 std::unique_lock<std::mutex> lock(_update->mutex);
                 options = _options;
             }
+            std::chrono::steady_clock::time_point renderStart;
             while (_renderRunning)
 			{
                 // Check for updates or settings changes.
                 bool update = false;
-                bool rendererChanged = false;
+                bool postProcess = false;
                 {
                     std::unique_lock<std::mutex> lock(_update->mutex);
                     if (_update->cv.wait_for(
@@ -303,23 +233,44 @@ namespace Osprey
                         std::chrono::milliseconds(100),
                         [this]
                     {
-                        return _update->update;
+                        return _update->update || _update->options;
                     }))
                     {
-                        update = true;
-                        rendererChanged = _options.rendererName != options.rendererName;
+                        // Changes to only the tone mapping or denoiser
+                        // are applied without restarting the accumulation.
+                        postProcess = !_update->update && Render::isPostProcessChange(options, _options);
+                        update = !postProcess && (_update->update || _options != options);
                         options = _options;
                         _update->update = false;
+                        _update->options = false;
                     }
                 }
 
-                if (update)
+                if (postProcess)
                 {
-                    // Update the change queue.
+                    // Render another pass if the denoiser changed after the
+                    // render finished, otherwise copy the last image again.
+                    const size_t totalPasses = options.passes + options.previewPasses;
+                    if (_render->setPostProcess(options) && _pass == totalPasses && _pass > 0)
+                    {
+                        --_pass;
+                    }
+                    else
+                    {
+                        _render->updateImage(*_rdkRenderWindow);
+                        SignalUpdate();
+                    }
+                }
+                else if (update)
+                {
+                    // Update the change queue. Changing the renderer only
+                    // re-binds the materials, the world is kept. Changing
+                    // the mesh flattening creates the world again.
                     _changeQueue->setRendererName(options.rendererName, options.supportsMaterials);
-                    if (rendererChanged)
+                    _changeQueue->setBVHPolicy(options.bvhPolicy);
+                    _changeQueue->setPointBudget(getPointBudgetValue(options.pointBudget));
+                    if (_changeQueue->setFlattenMeshes(options.flattenMeshes))
                     {
-                        rendererChanged = false;
                         _changeQueue->CreateWorld();
                     }
                     else
@@ -330,14 +281,29 @@ namespace Osprey
                     // Update the renderer.
                     _render->init(options, _scene);
                     _pass = 0;
+                    renderStart = std::chrono::steady_clock::now();
                 }
 
                 // Render a pass.
-                if (_pass < options.passes + options.previewPasses)
+                const size_t totalPasses = options.passes + options.previewPasses;
+                if (_pass < totalPasses)
                 {
-                    _render->render(_pass, *_rdkRenderWindow);
+                    // Cancel the pass when the renderer is stopped.
+                    if (!_render->render(_pass, *_rdkRenderWindow, [this](float)
+                    {
+                        return _renderRunning.load();
+                    }))
+                        continue;
                     ++_pass;
                     SignalUpdate();
+
+                    if (totalPasses == _pass)
+                    {
+                        std::stringstream ss;
+                        ss << "Render: " << totalPasses << " passes, " <<
+                            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - renderStart).count() << " ms";
+                        printDebug(ss.str());
+                    }
                 }
             }
 		});
@@ -359,6 +325,8 @@ namespace Osprey
 
 	std::shared_ptr<RhRdk::Realtime::DisplayMode> DisplayModeFactory::MakeDisplayEngine(const CRhinoDisplayPipeline& pipeline) const
 	{
+		if (!::OspreyPlugIn().InitOSPRay())
+			return nullptr;
 		return std::make_shared<DisplayMode>(pipeline, _settings);
 	}
 
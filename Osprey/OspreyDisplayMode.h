@@ -57,7 +57,11 @@ namespace Osprey
 	private:
 		void _startRenderer();
 
+		bool _createViewportImage(const ON_2iSize&);
+
 		std::unique_ptr<IRhRdkRenderWindow> _rdkRenderWindow;
+        std::shared_ptr<ViewportImage> _viewportImage;
+        bool _viewportImageLocked = false;
 
         Options _options;
         std::shared_ptr<Update> _update;
@@ -68,15 +72,7 @@ namespace Osprey
 		std::atomic<bool> _renderRunning;
         size_t _pass = 0;
 
-        std::shared_ptr<ValueObserver<Renderer> > _rendererObserver;
-        std::shared_ptr<ValueObserver<Passes> > _passesObserver;
-        std::shared_ptr<ValueObserver<PreviewPasses> > _previewPassesObserver;
-        std::shared_ptr<ValueObserver<PixelSamples> > _pixelSamplesObserver;
-        std::shared_ptr<ValueObserver<AOSamples> > _aoSamplesObserver;
-        std::shared_ptr<ValueObserver<bool> > _denoiserFoundObserver;
-        std::shared_ptr<ValueObserver<bool> > _denoiserEnabledObserver;
-        std::shared_ptr<ValueObserver<bool> > _toneMapperEnabledObserver;
-        std::shared_ptr<ValueObserver<Exposure> > _toneMapperExposureObserver;
+        std::shared_ptr<ValueObserver<Options> > _optionsObserver;
     };
 
 	class DisplayModeFactory : public RhRdk::Realtime::DisplayMode::Factory, public CRhRdkObject
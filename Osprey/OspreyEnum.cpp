@@ -207,4 +207,219 @@ namespace Osprey
         [static_cast<size_t>(value)];
     }
 
+    OSPREY_ENUM_HELPER_DEF(BVHPolicy);
+
+    std::wstring getBVHPolicyLabel(BVHPolicy value)
+    {
+        return std::vector<std::wstring>
+        {
+            L"Automatic",
+            L"Static",
+            L"Dynamic"
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    OSPREY_ENUM_HELPER_DEF(BucketSize);
+
+    size_t getBucketSizeValue(BucketSize value)
+    {
+        return std::vector<size_t>
+        {
+            0,
+            0,
+            256,
+            512,
+            1024,
+            2048,
+            4096
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    std::wstring getBucketSizeLabel(BucketSize value)
+    {
+        return std::vector<std::wstring>
+        {
+            L"Off",
+            L"Automatic",
+            L"256",
+            L"512",
+            L"1024",
+            L"2048",
+            L"4096"
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    OSPREY_ENUM_HELPER_DEF(Device);
+
+    std::wstring getDeviceLabel(Device value)
+    {
+        return std::vector<std::wstring>
+        {
+            L"Local",
+            L"MPI Offload"
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    OSPREY_ENUM_HELPER_DEF(ThreadCount);
+
+    size_t getThreadCountValue(ThreadCount value)
+    {
+        return std::vector<size_t>
+        {
+            0,
+            1,
+            2,
+            4,
+            8,
+            16,
+            32,
+            64
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    std::wstring getThreadCountLabel(ThreadCount value)
+    {
+        return std::vector<std::wstring>
+        {
+            L"Automatic",
+            L"1",
+            L"2",
+            L"4",
+            L"8",
+            L"16",
+            L"32",
+            L"64"
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    OSPREY_ENUM_HELPER_DEF(ReservedCores);
+
+    size_t getReservedCoresValue(ReservedCores value)
+    {
+        return std::vector<size_t>
+        {
+            0,
+            1,
+            2,
+            4
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    std::wstring getReservedCoresLabel(ReservedCores value)
+    {
+        return std::vector<std::wstring>
+        {
+            L"0",
+            L"1",
+            L"2",
+            L"4"
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    OSPREY_ENUM_HELPER_DEF(LogLevel);
+
+    std::string getLogLevelValue(LogLevel value)
+    {
+        return std::vector<std::string>
+        {
+            "debug",
+            "info",
+            "warning",
+            "error"
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    std::wstring getLogLevelLabel(LogLevel value)
+    {
+        return std::vector<std::wstring>
+        {
+            L"Debug",
+            L"Info",
+            L"Warning",
+            L"Error"
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    OSPREY_ENUM_HELPER_DEF(DenoiserInterval);
+
+    size_t getDenoiserIntervalPasses(DenoiserInterval value)
+    {
+        return std::vector<size_t>
+        {
+            1,
+            4,
+            16,
+            0,
+            0,
+            0
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    std::chrono::milliseconds getDenoiserIntervalTime(DenoiserInterval value)
+    {
+        return std::vector<std::chrono::milliseconds>
+        {
+            std::chrono::milliseconds(0),
+            std::chrono::milliseconds(0),
+            std::chrono::milliseconds(0),
+            std::chrono::milliseconds(1000),
+            std::chrono::milliseconds(5000),
+            std::chrono::milliseconds(0)
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    std::wstring getDenoiserIntervalLabel(DenoiserInterval value)
+    {
+        return std::vector<std::wstring>
+        {
+            L"Every pass",
+            L"4 passes",
+            L"16 passes",
+            L"1 second",
+            L"5 seconds",
+            L"Last pass"
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    OSPREY_ENUM_HELPER_DEF(PointBudget);
+
+    size_t getPointBudgetValue(PointBudget value)
+    {
+        return std::vector<size_t>
+        {
+            0,
+            1000000,
+            5000000,
+            10000000,
+            20000000
+        }
+            [static_cast<size_t>(value)];
+    }
+
+    std::wstring getPointBudgetLabel(PointBudget value)
+    {
+        return std::vector<std::wstring>
+        {
+            L"Unlimited",
+            L"1 million",
+            L"5 million",
+            L"10 million",
+            L"20 million"
+        }
+            [static_cast<size_t>(value)];
+    }
+
 } // namespace Osprey
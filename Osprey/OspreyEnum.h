@@ -121,6 +121,136 @@ namespace Osprey
     float getExposureValue(Exposure);
     std::wstring getExposureLabel(Exposure);
 
+    //! The policy for building the BVH acceleration structures.
+    enum class BVHPolicy
+    {
+        Automatic,
+        Static,
+        Dynamic,
+
+        Count,
+        First = Automatic
+    };
+    OSPREY_ENUM_HELPER(BVHPolicy);
+    std::wstring getBVHPolicyLabel(BVHPolicy);
+
+    //! The size of the buckets for final renders. Rendering in buckets
+    //! reduces the frame buffer memory for large images.
+    enum class BucketSize
+    {
+        Off,
+        Automatic,
+        _256,
+        _512,
+        _1024,
+        _2048,
+        _4096,
+
+        Count,
+        First = Off
+    };
+    OSPREY_ENUM_HELPER(BucketSize);
+    size_t getBucketSizeValue(BucketSize);
+    std::wstring getBucketSizeLabel(BucketSize);
+
+    //! The OSPRay device. The MPI offload device distributes the rendering
+    //! over MPI ranks, either on the local machine or on a cluster.
+    enum class Device
+    {
+        Local,
+        MPIOffload,
+
+        Count,
+        First = Local
+    };
+    OSPREY_ENUM_HELPER(Device);
+    std::wstring getDeviceLabel(Device);
+
+    //! The number of render threads, the automatic setting uses all of the
+    //! hardware threads that are not reserved.
+    enum class ThreadCount
+    {
+        Automatic,
+        _1,
+        _2,
+        _4,
+        _8,
+        _16,
+        _32,
+        _64,
+
+        Count,
+        First = Automatic
+    };
+    OSPREY_ENUM_HELPER(ThreadCount);
+    size_t getThreadCountValue(ThreadCount);
+    std::wstring getThreadCountLabel(ThreadCount);
+
+    //! The number of hardware threads reserved for Rhino.
+    enum class ReservedCores
+    {
+        _0,
+        _1,
+        _2,
+        _4,
+
+        Count,
+        First = _0
+    };
+    OSPREY_ENUM_HELPER(ReservedCores);
+    size_t getReservedCoresValue(ReservedCores);
+    std::wstring getReservedCoresLabel(ReservedCores);
+
+    //! The level of the log messages that are printed.
+    enum class LogLevel
+    {
+        Debug,
+        Info,
+        Warning,
+        Error,
+
+        Count,
+        First = Debug
+    };
+    OSPREY_ENUM_HELPER(LogLevel);
+    std::string getLogLevelValue(LogLevel);
+    std::wstring getLogLevelLabel(LogLevel);
+
+    //! How often the denoiser is applied while the passes accumulate. The
+    //! last pass is always denoised.
+    enum class DenoiserInterval
+    {
+        EveryPass,
+        _4Passes,
+        _16Passes,
+        _1Second,
+        _5Seconds,
+        LastPass,
+
+        Count,
+        First = EveryPass
+    };
+    OSPREY_ENUM_HELPER(DenoiserInterval);
+    size_t getDenoiserIntervalPasses(DenoiserInterval);
+    std::chrono::milliseconds getDenoiserIntervalTime(DenoiserInterval);
+    std::wstring getDenoiserIntervalLabel(DenoiserInterval);
+
+    //! The maximum number of point cloud points rendered in the viewport.
+    enum class PointBudget
+    {
+        Unlimited,
+        _1M,
+        _5M,
+        _10M,
+        _20M,
+
+        Count,
+        First = Unlimited
+    };
+    OSPREY_ENUM_HELPER(PointBudget);
+    size_t getPointBudgetValue(PointBudget);
+    std::wstring getPointBudgetLabel(PointBudget);
+
     enum class BackgroundType
     {
         Solid,
@@ -3,6 +3,7 @@
 
 #include "StdAfx.h"
 #include "OspreyEventWatcher.h"
+#include "OspreyPlugIn.h"
 
 COspreyEventWatcher::COspreyEventWatcher()
 {
@@ -126,7 +127,7 @@ void COspreyEventWatcher::OnCloseRhino(CRhinoApp& app)
 
 void COspreyEventWatcher::OnCloseDocument(CRhinoDoc& doc)
 {
-	UNREFERENCED_PARAMETER(doc);
+	::OspreyPlugIn().ReleaseDocument(doc);
 }
 
 void COspreyEventWatcher::OnNewDocument(CRhinoDoc& doc)
@@ -0,0 +1,326 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#pragma once
+
+namespace Osprey
+{
+    //! This struct provides the hash functions for flat map keys.
+    template<typename T>
+    struct FlatHash;
+
+    template<>
+    struct FlatHash<ON__UINT32>
+    {
+        size_t operator () (ON__UINT32) const;
+    };
+
+    template<>
+    struct FlatHash<ON_UUID>
+    {
+        size_t operator () (const ON_UUID&) const;
+    };
+
+    template<>
+    struct FlatHash<std::wstring>
+    {
+        size_t operator () (const std::wstring&) const;
+    };
+
+    //! This class provides a hash map that stores the values in a flat array
+    //! using open addressing with linear probing. It is used for the large
+    //! lookup tables where the nodes of std::map would be too expensive.
+    //!
+    //! Iterators are invalidated by insertion and removal.
+    template<typename K, typename V, typename H = FlatHash<K> >
+    class FlatMap
+    {
+    public:
+        typedef std::pair<K, V> value_type;
+
+        //! This class provides an iterator over the values.
+        template<typename M, typename P>
+        class Iterator
+        {
+        public:
+            Iterator() = default;
+
+            Iterator(M* map, size_t index) :
+                _map(map),
+                _index(index)
+            {
+                const size_t count = _map->_used.size();
+                while (_index < count && !_map->_used[_index])
+                {
+                    ++_index;
+                }
+            }
+
+            template<typename M2, typename P2>
+            Iterator(const Iterator<M2, P2>& other) :
+                _map(other.map()),
+                _index(other.index())
+            {}
+
+            P& operator * () const { return _map->_slots[_index]; }
+            P* operator -> () const { return &_map->_slots[_index]; }
+
+            Iterator& operator ++ ()
+            {
+                *this = Iterator(_map, _index + 1);
+                return *this;
+            }
+
+            bool operator == (const Iterator& other) const { return _index == other._index; }
+            bool operator != (const Iterator& other) const { return _index != other._index; }
+
+            M* map() const { return _map; }
+            size_t index() const { return _index; }
+
+        private:
+            M* _map = nullptr;
+            size_t _index = 0;
+        };
+
+        typedef Iterator<FlatMap, value_type> iterator;
+        typedef Iterator<const FlatMap, const value_type> const_iterator;
+
+        FlatMap() = default;
+
+        //! Get the number of values.
+        size_t size() const;
+
+        //! Get whether the map is empty.
+        bool empty() const;
+
+        //! Remove all of the values.
+        void clear();
+
+        //! Reserve storage for the given number of values.
+        void reserve(size_t);
+
+        iterator begin();
+        iterator end();
+        const_iterator begin() const;
+        const_iterator end() const;
+
+        //! Find a value.
+        iterator find(const K&);
+        const_iterator find(const K&) const;
+
+        //! Get a value, inserting a default value if it does not exist.
+        V& operator [] (const K&);
+
+        //! Remove a value.
+        void erase(const_iterator);
+
+        //! Remove a value.
+        bool erase(const K&);
+
+    private:
+        size_t _findSlot(const K&) const;
+        void _eraseSlot(size_t);
+        void _rehash(size_t);
+
+        std::vector<value_type> _slots;
+        std::vector<uint8_t> _used;
+        size_t _size = 0;
+        size_t _mask = 0;
+    };
+
+    inline size_t FlatHash<ON__UINT32>::operator () (ON__UINT32 value) const
+    {
+        // MurmurHash3 finalizer, the instance IDs are sequential.
+        uint64_t h = value;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+    inline size_t FlatHash<ON_UUID>::operator () (const ON_UUID& value) const
+    {
+        uint64_t h[2];
+        memcpy(h, &value, sizeof(h));
+        return static_cast<size_t>(h[0] ^ (h[1] * 0x9e3779b97f4a7c15ULL));
+    }
+
+    inline size_t FlatHash<std::wstring>::operator () (const std::wstring& value) const
+    {
+        return std::hash<std::wstring>()(value);
+    }
+
+    template<typename K, typename V, typename H>
+    inline size_t FlatMap<K, V, H>::size() const
+    {
+        return _size;
+    }
+
+    template<typename K, typename V, typename H>
+    inline bool FlatMap<K, V, H>::empty() const
+    {
+        return 0 == _size;
+    }
+
+    template<typename K, typename V, typename H>
+    inline void FlatMap<K, V, H>::clear()
+    {
+        _slots.clear();
+        _used.clear();
+        _size = 0;
+        _mask = 0;
+    }
+
+    template<typename K, typename V, typename H>
+    inline void FlatMap<K, V, H>::reserve(size_t value)
+    {
+        // Keep the load factor below one half.
+        size_t capacity = 16;
+        while (capacity < value * 2)
+        {
+            capacity *= 2;
+        }
+        if (capacity > _slots.size())
+        {
+            _rehash(capacity);
+        }
+    }
+
+    template<typename K, typename V, typename H>
+    inline typename FlatMap<K, V, H>::iterator FlatMap<K, V, H>::begin()
+    {
+        return iterator(this, 0);
+    }
+
+    template<typename K, typename V, typename H>
+    inline typename FlatMap<K, V, H>::iterator FlatMap<K, V, H>::end()
+    {
+        return iterator(this, _slots.size());
+    }
+
+    template<typename K, typename V, typename H>
+    inline typename FlatMap<K, V, H>::const_iterator FlatMap<K, V, H>::begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    template<typename K, typename V, typename H>
+    inline typename FlatMap<K, V, H>::const_iterator FlatMap<K, V, H>::end() const
+    {
+        return const_iterator(this, _slots.size());
+    }
+
+    template<typename K, typename V, typename H>
+    inline typename FlatMap<K, V, H>::iterator FlatMap<K, V, H>::find(const K& key)
+    {
+        const size_t i = _findSlot(key);
+        return i < _slots.size() && _used[i] ? iterator(this, i) : end();
+    }
+
+    template<typename K, typename V, typename H>
+    inline typename FlatMap<K, V, H>::const_iterator FlatMap<K, V, H>::find(const K& key) const
+    {
+        const size_t i = _findSlot(key);
+        return i < _slots.size() && _used[i] ? const_iterator(this, i) : end();
+    }
+
+    template<typename K, typename V, typename H>
+    inline V& FlatMap<K, V, H>::operator [] (const K& key)
+    {
+        if ((_size + 1) * 2 > _slots.size())
+        {
+            _rehash(std::max(_slots.size() * 2, size_t(16)));
+        }
+        const size_t i = _findSlot(key);
+        if (!_used[i])
+        {
+            _slots[i] = value_type(key, V());
+            _used[i] = 1;
+            ++_size;
+        }
+        return _slots[i].second;
+    }
+
+    template<typename K, typename V, typename H>
+    inline void FlatMap<K, V, H>::erase(const_iterator value)
+    {
+        _eraseSlot(value.index());
+    }
+
+    template<typename K, typename V, typename H>
+    inline bool FlatMap<K, V, H>::erase(const K& key)
+    {
+        const size_t i = _findSlot(key);
+        if (i < _slots.size() && _used[i])
+        {
+            _eraseSlot(i);
+            return true;
+        }
+        return false;
+    }
+
+    template<typename K, typename V, typename H>
+    inline size_t FlatMap<K, V, H>::_findSlot(const K& key) const
+    {
+        // Returns the slot containing the key, or the empty slot where it
+        // would be inserted.
+        if (_slots.empty())
+            return 0;
+        size_t i = H()(key) & _mask;
+        while (_used[i] && !(_slots[i].first == key))
+        {
+            i = (i + 1) & _mask;
+        }
+        return i;
+    }
+
+    template<typename K, typename V, typename H>
+    inline void FlatMap<K, V, H>::_eraseSlot(size_t i)
+    {
+        _slots[i] = value_type();
+        _used[i] = 0;
+        --_size;
+
+        // Shift the following values of the probe sequence back so that no
+        // tombstones are needed.
+        size_t j = i;
+        while (true)
+        {
+            j = (j + 1) & _mask;
+            if (!_used[j])
+                break;
+            const size_t k = H()(_slots[j].first) & _mask;
+            const bool inRange = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+            if (!inRange)
+            {
+                _slots[i] = std::move(_slots[j]);
+                _used[i] = 1;
+                _slots[j] = value_type();
+                _used[j] = 0;
+                i = j;
+            }
+        }
+    }
+
+    template<typename K, typename V, typename H>
+    inline void FlatMap<K, V, H>::_rehash(size_t capacity)
+    {
+        std::vector<value_type> slots(capacity);
+        std::vector<uint8_t> used(capacity, 0);
+        std::swap(slots, _slots);
+        std::swap(used, _used);
+        _mask = capacity - 1;
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            if (used[i])
+            {
+                const size_t j = _findSlot(slots[i].first);
+                _slots[j] = std::move(slots[i]);
+                _used[j] = 1;
+            }
+        }
+    }
+
+} // namespace Osprey
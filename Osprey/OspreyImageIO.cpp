@@ -0,0 +1,337 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#include "stdafx.h"
+#include "OspreyImageIO.h"
+#include "OspreyUtil.h"
+
+namespace Osprey
+{
+    namespace
+    {
+        const int tileSize = 64;
+
+        const int exrMagic = 20000630;
+        const int exrVersion = 2;
+        const int exrTiledFlag = 0x200;
+        const uint8_t exrCompressionRLE = 1;
+        const uint8_t exrLineOrderRandomY = 2;
+        const int exrPixelTypeFloat = 2;
+
+        template<typename T>
+        void append(std::vector<uint8_t>& out, T value)
+        {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+            out.insert(out.end(), p, p + sizeof(T));
+        }
+
+        class HeaderWriter
+        {
+        public:
+            void attribute(const char* name, const char* type, const std::vector<uint8_t>& value)
+            {
+                string(name);
+                string(type);
+                append<int32_t>(data, static_cast<int32_t>(value.size()));
+                data.insert(data.end(), value.begin(), value.end());
+            }
+
+            void string(const char* value)
+            {
+                data.insert(data.end(), value, value + strlen(value) + 1);
+            }
+
+            std::vector<uint8_t> data;
+        };
+
+        std::vector<uint8_t> box2i(int xMin, int yMin, int xMax, int yMax)
+        {
+            std::vector<uint8_t> out;
+            append<int32_t>(out, xMin);
+            append<int32_t>(out, yMin);
+            append<int32_t>(out, xMax);
+            append<int32_t>(out, yMax);
+            return out;
+        }
+
+        //! Compress data with the OpenEXR RLE compression. The bytes are split
+        //! into two halves and delta encoded before the run length encoding.
+        //! Returns the compressed size.
+        size_t compressRLE(const uint8_t* in, size_t size, std::vector<uint8_t>& tmp, std::vector<uint8_t>& out)
+        {
+            tmp.resize(size);
+            uint8_t* t1 = tmp.data();
+            uint8_t* t2 = tmp.data() + (size + 1) / 2;
+            for (size_t i = 0; i < size; ++i)
+            {
+                if (0 == i % 2)
+                {
+                    *t1++ = in[i];
+                }
+                else
+                {
+                    *t2++ = in[i];
+                }
+            }
+            int p = size > 0 ? tmp[0] : 0;
+            for (size_t i = 1; i < size; ++i)
+            {
+                const int d = static_cast<int>(tmp[i]) - p + (128 + 256);
+                p = tmp[i];
+                tmp[i] = static_cast<uint8_t>(d);
+            }
+
+            const int minRunLength = 3;
+            const int maxRunLength = 127;
+            out.resize(size * 2 + 2);
+            const uint8_t* inEnd = tmp.data() + size;
+            const uint8_t* runStart = tmp.data();
+            const uint8_t* runEnd = tmp.data() + 1;
+            uint8_t* outP = out.data();
+            while (runStart < inEnd)
+            {
+                while (runEnd < inEnd && *runStart == *runEnd && runEnd - runStart - 1 < maxRunLength)
+                {
+                    ++runEnd;
+                }
+                if (runEnd - runStart >= minRunLength)
+                {
+                    // A run of the same value.
+                    *outP++ = static_cast<uint8_t>((runEnd - runStart) - 1);
+                    *outP++ = *runStart;
+                    runStart = runEnd;
+                }
+                else
+                {
+                    // A run of different values.
+                    while (runEnd < inEnd &&
+                        ((runEnd + 1 >= inEnd || *runEnd != *(runEnd + 1)) ||
+                        (runEnd + 2 >= inEnd || *(runEnd + 1) != *(runEnd + 2))) &&
+                        runEnd - runStart < maxRunLength)
+                    {
+                        ++runEnd;
+                    }
+                    *outP++ = static_cast<uint8_t>(runStart - runEnd);
+                    while (runStart < runEnd)
+                    {
+                        *outP++ = *runStart++;
+                    }
+                }
+                ++runEnd;
+            }
+            return outP - out.data();
+        }
+
+    } // namespace
+
+    EXRWriter::EXRWriter()
+    {}
+
+    EXRWriter::~EXRWriter()
+    {
+        if (_f)
+        {
+            fclose(_f);
+        }
+    }
+
+    std::shared_ptr<EXRWriter> EXRWriter::create(
+        const std::wstring& fileName,
+        const ospcommon::math::vec2i& size,
+        const std::vector<std::string>& channels)
+    {
+        auto out = std::shared_ptr<EXRWriter>(new EXRWriter);
+        out->_size = size;
+        out->_channels = channels;
+        for (size_t i = 0; i < channels.size(); ++i)
+        {
+            out->_channelOrder.push_back(i);
+        }
+        std::sort(out->_channelOrder.begin(), out->_channelOrder.end(), [&channels](size_t a, size_t b)
+        {
+            return channels[a] < channels[b];
+        });
+        out->_tileCount = ospcommon::math::vec2i(
+            (size.x + tileSize - 1) / tileSize,
+            (size.y + tileSize - 1) / tileSize);
+        out->_offsets.resize(out->_tileCount.x * out->_tileCount.y, 0);
+
+        if (_wfopen_s(&out->_f, fileName.c_str(), L"wb") != 0 || !out->_f)
+        {
+            out->_f = nullptr;
+            printError("Cannot open file for writing");
+            return nullptr;
+        }
+
+        HeaderWriter header;
+        append<int32_t>(header.data, exrMagic);
+        append<int32_t>(header.data, exrVersion | exrTiledFlag);
+        {
+            HeaderWriter chlist;
+            for (size_t i : out->_channelOrder)
+            {
+                // The pixel type, linear flag with reserved bytes, and the
+                // sampling.
+                chlist.string(channels[i].c_str());
+                append<int32_t>(chlist.data, exrPixelTypeFloat);
+                append<int32_t>(chlist.data, 0);
+                append<int32_t>(chlist.data, 1);
+                append<int32_t>(chlist.data, 1);
+            }
+            append<uint8_t>(chlist.data, 0);
+            header.attribute("channels", "chlist", chlist.data);
+        }
+        header.attribute("compression", "compression", { exrCompressionRLE });
+        header.attribute("dataWindow", "box2i", box2i(0, 0, size.x - 1, size.y - 1));
+        header.attribute("displayWindow", "box2i", box2i(0, 0, size.x - 1, size.y - 1));
+        header.attribute("lineOrder", "lineOrder", { exrLineOrderRandomY });
+        {
+            std::vector<uint8_t> value;
+            append<float>(value, 1.F);
+            header.attribute("pixelAspectRatio", "float", value);
+        }
+        {
+            std::vector<uint8_t> value;
+            append<float>(value, 0.F);
+            append<float>(value, 0.F);
+            header.attribute("screenWindowCenter", "v2f", value);
+        }
+        {
+            std::vector<uint8_t> value;
+            append<float>(value, 1.F);
+            header.attribute("screenWindowWidth", "float", value);
+        }
+        {
+            // One level with the tiles rounded down.
+            std::vector<uint8_t> value;
+            append<uint32_t>(value, tileSize);
+            append<uint32_t>(value, tileSize);
+            append<uint8_t>(value, 0);
+            header.attribute("tiles", "tiledesc", value);
+        }
+        append<uint8_t>(header.data, 0);
+        out->_write(header.data.data(), header.data.size());
+
+        // Reserve the offset table, it is filled in when the file is closed.
+        out->_offsetTablePos = out->_pos;
+        out->_write(out->_offsets.data(), out->_offsets.size() * sizeof(uint64_t));
+
+        return out;
+    }
+
+    int EXRWriter::getTileSize()
+    {
+        return tileSize;
+    }
+
+    bool EXRWriter::writeTiles(
+        const ospcommon::math::box2i& rect,
+        const std::vector<Input>& inputs,
+        bool flipY)
+    {
+        if (inputs.size() != _channels.size() ||
+            rect.lower.x % tileSize != 0 ||
+            rect.lower.y % tileSize != 0 ||
+            (rect.upper.x % tileSize != 0 && rect.upper.x != _size.x) ||
+            (rect.upper.y % tileSize != 0 && rect.upper.y != _size.y))
+        {
+            printError("Invalid EXR tile rectangle");
+            return false;
+        }
+
+        const ospcommon::math::vec2i rectSize = rect.size();
+        const ospcommon::math::vec2i tileStart = rect.lower / tileSize;
+        const ospcommon::math::vec2i tileEnd(
+            (rect.upper.x + tileSize - 1) / tileSize,
+            (rect.upper.y + tileSize - 1) / tileSize);
+        const int tilesX = tileEnd.x - tileStart.x;
+        const int tiles = tilesX * (tileEnd.y - tileStart.y);
+        tbb::parallel_for(tbb::blocked_range<int>(0, tiles), [&](const tbb::blocked_range<int>& r)
+        {
+            std::vector<uint8_t> data;
+            std::vector<uint8_t> tmp;
+            std::vector<uint8_t> compressed;
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                const int tileX = tileStart.x + i % tilesX;
+                const int tileY = tileStart.y + i / tilesX;
+                const int x0 = tileX * tileSize;
+                const int y0 = tileY * tileSize;
+                const int w = std::min(tileSize, _size.x - x0);
+                const int h = std::min(tileSize, _size.y - y0);
+
+                // Gather the pixels, each scanline stores the channels one
+                // after another.
+                data.resize(static_cast<size_t>(w) * h * _channels.size() * sizeof(float));
+                float* dataP = reinterpret_cast<float*>(data.data());
+                for (int y = 0; y < h; ++y)
+                {
+                    const int rectY = y0 + y - rect.lower.y;
+                    const size_t row = flipY ? rectSize.y - 1 - rectY : rectY;
+                    for (size_t c : _channelOrder)
+                    {
+                        const Input& input = inputs[c];
+                        const float* inP = input.data + (row * rectSize.x + (x0 - rect.lower.x)) * input.pixelStride;
+                        for (int x = 0; x < w; ++x, inP += input.pixelStride)
+                        {
+                            *dataP++ = *inP;
+                        }
+                    }
+                }
+
+                // The data is stored uncompressed when compression does not
+                // make it smaller.
+                const size_t compressedSize = compressRLE(data.data(), data.size(), tmp, compressed);
+                const uint8_t* chunk = compressedSize < data.size() ? compressed.data() : data.data();
+                const int32_t chunkSize = static_cast<int32_t>(std::min(compressedSize, data.size()));
+
+                std::lock_guard<std::mutex> lock(_mutex);
+                _offsets[tileY * _tileCount.x + tileX] = _pos;
+                const int32_t chunkHeader[] = { tileX, tileY, 0, 0, chunkSize };
+                _write(chunkHeader, sizeof(chunkHeader));
+                _write(chunk, chunkSize);
+            }
+        });
+        return !_error;
+    }
+
+    bool EXRWriter::close()
+    {
+        if (!_f)
+            return false;
+
+        bool out = !_error;
+        if (std::find(_offsets.begin(), _offsets.end(), 0) != _offsets.end())
+        {
+            printError("Incomplete EXR image");
+            out = false;
+        }
+        if (_fseeki64(_f, static_cast<__int64>(_offsetTablePos), SEEK_SET) != 0 ||
+            fwrite(_offsets.data(), sizeof(uint64_t), _offsets.size(), _f) != _offsets.size())
+        {
+            out = false;
+        }
+        if (fclose(_f) != 0)
+        {
+            out = false;
+        }
+        _f = nullptr;
+        return out;
+    }
+
+    void EXRWriter::_write(const void* data, size_t size)
+    {
+        if (size > 0 && fwrite(data, 1, size, _f) != size)
+        {
+            _error = true;
+        }
+        _pos += size;
+    }
+
+    bool isEXRFileName(const std::wstring& fileName)
+    {
+        const size_t i = fileName.rfind(L'.');
+        return i != std::wstring::npos && 0 == _wcsicmp(fileName.c_str() + i, L".exr");
+    }
+
+} // namespace Osprey
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#pragma once
+
+namespace Osprey
+{
+    //! This class writes floating point OpenEXR images. The image is stored
+    //! as RLE compressed tiles, the tiles are compressed in parallel and
+    //! written to the file as soon as they are finished so that the whole
+    //! image never needs to be in memory.
+    class EXRWriter
+    {
+        EXRWriter();
+        EXRWriter(const EXRWriter&) = delete;
+        EXRWriter& operator = (const EXRWriter&) = delete;
+
+    public:
+        ~EXRWriter();
+
+        //! The source of the pixel data for a channel.
+        struct Input
+        {
+            const float* data = nullptr;
+            //! The number of floats between pixels.
+            size_t pixelStride = 1;
+        };
+
+        // Create a new instance. Returns nullptr if the file cannot be opened.
+        static std::shared_ptr<EXRWriter> create(
+            const std::wstring& fileName,
+            const ospcommon::math::vec2i& size,
+            const std::vector<std::string>& channels);
+
+        //! Get the tile size. The rectangles given to writeTiles() must start
+        //! on a tile boundary.
+        static int getTileSize();
+
+        //! Write the tiles covered by a rectangle. There is one input per
+        //! channel in the order given to create(). The rows of the input are
+        //! ordered from bottom to top if flipY is true.
+        bool writeTiles(
+            const ospcommon::math::box2i&,
+            const std::vector<Input>&,
+            bool flipY);
+
+        //! Finish writing the file. Returns false if there was an error or
+        //! not all of the tiles were written.
+        bool close();
+
+    private:
+        void _write(const void*, size_t);
+
+        FILE* _f = nullptr;
+        ospcommon::math::vec2i _size;
+        std::vector<std::string> _channels;
+        //! The order of the channels in the file, which is sorted by name.
+        std::vector<size_t> _channelOrder;
+        ospcommon::math::vec2i _tileCount;
+        uint64_t _offsetTablePos = 0;
+        std::vector<uint64_t> _offsets;
+        uint64_t _pos = 0;
+        bool _error = false;
+        std::mutex _mutex;
+    };
+
+    //! Get whether a file name has the OpenEXR extension.
+    bool isEXRFileName(const std::wstring&);
+
+} // namespace Osprey
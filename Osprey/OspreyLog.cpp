@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#include "stdafx.h"
+#include "OspreyLog.h"
+
+namespace Osprey
+{
+    namespace
+    {
+        // The number of buffered messages.
+        const size_t logBufferCapacity = 4096;
+
+        // The maximum number of messages printed to the command history per
+        // second.
+        const size_t printRateMax = 50;
+
+        const char* getLevelLabel(LogLevel value)
+        {
+            switch (value)
+            {
+            case LogLevel::Debug: return "debug";
+            case LogLevel::Warning: return "warning";
+            case LogLevel::Error: return "error";
+            default: break;
+            }
+            return "info";
+        }
+
+        //! Write a JSON string with the special characters escaped.
+        void writeJSONString(FILE* f, const std::string& value)
+        {
+            fputc('"', f);
+            for (const char c : value)
+            {
+                switch (c)
+                {
+                case '"': fputs("\\\"", f); break;
+                case '\\': fputs("\\\\", f); break;
+                case '\n': fputs("\\n", f); break;
+                case '\r': fputs("\\r", f); break;
+                case '\t': fputs("\\t", f); break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                    {
+                        fprintf(f, "\\u%04x", c);
+                    }
+                    else
+                    {
+                        fputc(c, f);
+                    }
+                    break;
+                }
+            }
+            fputc('"', f);
+        }
+
+        struct LogData
+        {
+            std::unique_ptr<LogBuffer> buffer;
+            std::thread::id uiThread;
+            std::atomic<LogLevel> level{ LogLevel::Info };
+            std::atomic<size_t> overflow{ 0 };
+            std::chrono::steady_clock::time_point start;
+            std::chrono::steady_clock::time_point printWindow;
+            size_t printCount = 0;
+            size_t printDropped = 0;
+            FILE* file = nullptr;
+        };
+
+        LogData logData;
+
+    } // namespace
+
+    LogBuffer::LogBuffer(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        _slots.reset(new Slot[size]);
+        _mask = size - 1;
+        for (size_t i = 0; i < size; ++i)
+        {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool LogBuffer::push(LogLevel level, const char* text)
+    {
+        // Claim a slot, the sequence number of the slot tells whether it has
+        // been consumed.
+        size_t pos = _pushPos.load(std::memory_order_relaxed);
+        Slot* slot = nullptr;
+        while (true)
+        {
+            slot = &_slots[pos & _mask];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (0 == diff)
+            {
+                if (_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = _pushPos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->level = level;
+        slot->time = std::chrono::steady_clock::now();
+        slot->threadId = static_cast<uint32_t>(GetCurrentThreadId());
+        strncpy_s(slot->text, text ? text : "", _TRUNCATE);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool LogBuffer::pop(LogItem& item)
+    {
+        Slot& slot = _slots[_popPos & _mask];
+        if (slot.sequence.load(std::memory_order_acquire) != _popPos + 1)
+            return false;
+        item.level = slot.level;
+        item.time = slot.time;
+        item.threadId = slot.threadId;
+        item.text = slot.text;
+        slot.sequence.store(_popPos + _mask + 1, std::memory_order_release);
+        ++_popPos;
+        return true;
+    }
+
+    void initLog()
+    {
+        logData.buffer.reset(new LogBuffer(logBufferCapacity));
+        logData.uiThread = std::this_thread::get_id();
+        logData.start = std::chrono::steady_clock::now();
+        logData.printWindow = logData.start;
+    }
+
+    void shutdownLog()
+    {
+        drainLog();
+        setLogFile(std::wstring());
+    }
+
+    LogLevel getLogLevel()
+    {
+        return logData.level.load();
+    }
+
+    void setLogLevel(LogLevel value)
+    {
+        logData.level = value;
+    }
+
+    void setLogFile(const std::wstring& fileName)
+    {
+        if (std::this_thread::get_id() != logData.uiThread)
+            return;
+        drainLog();
+        if (logData.file)
+        {
+            fclose(logData.file);
+            logData.file = nullptr;
+        }
+        if (!fileName.empty())
+        {
+            if (_wfopen_s(&logData.file, fileName.c_str(), L"a") != 0)
+            {
+                logData.file = nullptr;
+                RhinoApp().Print(L"Osprey ERROR: Cannot open the log file: %s\n", fileName.c_str());
+            }
+        }
+    }
+
+    void log(LogLevel level, const char* text)
+    {
+        if (level < logData.level.load(std::memory_order_relaxed) || !logData.buffer)
+            return;
+        if (!logData.buffer->push(level, text))
+        {
+            ++logData.overflow;
+        }
+        drainLog();
+    }
+
+    void drainLog()
+    {
+        if (std::this_thread::get_id() != logData.uiThread || !logData.buffer)
+            return;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - logData.printWindow >= std::chrono::seconds(1))
+        {
+            if (logData.printDropped > 0)
+            {
+                RhinoApp().Print("Osprey: %d messages not shown\n", static_cast<int>(logData.printDropped));
+            }
+            logData.printWindow = now;
+            logData.printCount = 0;
+            logData.printDropped = 0;
+        }
+
+        LogItem item;
+        while (logData.buffer->pop(item))
+        {
+            if (logData.printCount < printRateMax || LogLevel::Error == item.level)
+            {
+                ++logData.printCount;
+                if (LogLevel::Error == item.level)
+                {
+                    RhinoApp().Print("Osprey ERROR: %s\n", item.text.c_str());
+                }
+                else
+                {
+                    RhinoApp().Print("Osprey: %s\n", item.text.c_str());
+                }
+            }
+            else
+            {
+                ++logData.printDropped;
+            }
+
+            if (logData.file)
+            {
+                fprintf(
+                    logData.file,
+                    "{\"time\": %.3f, \"level\": \"%s\", \"thread\": %u, \"message\": ",
+                    std::chrono::duration<double>(item.time - logData.start).count(),
+                    getLevelLabel(item.level),
+                    item.threadId);
+                writeJSONString(logData.file, item.text);
+                fputs("}\n", logData.file);
+            }
+        }
+        if (logData.file)
+        {
+            fflush(logData.file);
+        }
+
+        const size_t overflow = logData.overflow.exchange(0);
+        if (overflow > 0)
+        {
+            RhinoApp().Print("Osprey: %d messages lost, the log buffer was full\n", static_cast<int>(overflow));
+        }
+    }
+
+} // namespace Osprey
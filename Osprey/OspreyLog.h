@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#pragma once
+
+#include "OspreyEnum.h"
+
+namespace Osprey
+{
+    //! This struct provides a log message.
+    struct LogItem
+    {
+        LogLevel level = LogLevel::Info;
+        std::chrono::steady_clock::time_point time;
+        uint32_t threadId = 0;
+        std::string text;
+    };
+
+    //! This class provides a bounded lock-free queue for log messages. Any
+    //! number of threads can add messages, and a single thread removes them.
+    //! Messages longer than the maximum size are truncated.
+    class LogBuffer
+    {
+    public:
+        //! The capacity is rounded up to a power of two.
+        explicit LogBuffer(size_t capacity);
+
+        //! Add a message. Returns false if the buffer is full.
+        bool push(LogLevel, const char*);
+
+        //! Remove the oldest message. Returns false if the buffer is empty.
+        bool pop(LogItem&);
+
+        static const size_t textSizeMax = 256;
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> sequence;
+            LogLevel level = LogLevel::Info;
+            std::chrono::steady_clock::time_point time;
+            uint32_t threadId = 0;
+            char text[textSizeMax];
+        };
+
+        std::unique_ptr<Slot[]> _slots;
+        size_t _mask = 0;
+        std::atomic<size_t> _pushPos{ 0 };
+        size_t _popPos = 0;
+    };
+
+    //! Initialize logging. The calling thread is the user interface thread
+    //! that prints the messages.
+    void initLog();
+
+    //! Print the remaining messages and close the log file.
+    void shutdownLog();
+
+    //! Get the log level.
+    LogLevel getLogLevel();
+
+    //! Set the log level. Messages below the level are ignored.
+    void setLogLevel(LogLevel);
+
+    //! Set the log file. The messages are written to the file as JSON lines
+    //! with the time, level and thread. An empty file name closes the file.
+    void setLogFile(const std::wstring&);
+
+    //! Add a message to the log. This can be called from any thread without
+    //! blocking, the message is printed the next time the log is drained.
+    //! Messages added from the user interface thread are printed immediately.
+    void log(LogLevel, const char*);
+
+    //! Print the buffered messages to the command history and the log file.
+    //! Nothing is done unless this is called from the user interface thread.
+    //! The number of messages printed to the command history is limited per
+    //! second, the rest are only counted.
+    void drainLog();
+
+} // namespace Osprey
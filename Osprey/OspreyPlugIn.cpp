@@ -4,7 +4,10 @@
 #include "StdAfx.h"
 #include "rhinoSdkPlugInDeclare.h"
 #include "OspreyDisplayMode.h"
+#include "OspreyLog.h"
 #include "OspreyPlugIn.h"
+#include "OspreyQuietRender.h"
+#include "OspreyResidentScene.h"
 #include "OspreyRdkPlugIn.h"
 #include "OspreySdkRender.h"
 #include "OspreySettings.h"
@@ -36,6 +39,59 @@ RHINO_PLUG_IN_UPDATE_URL(L"https://github.com/darbyjohnston/Osprey");
 
 static class COspreyPlugIn thePlugIn;
 
+namespace
+{
+	// The profile entries for the device settings.
+	const wchar_t* profileSection = L"Settings";
+	const wchar_t* profileDevice = L"Device";
+	const wchar_t* profileThreadCount = L"ThreadCount";
+	const wchar_t* profileReservedCores = L"ReservedCores";
+	const wchar_t* profileThreadAffinity = L"ThreadAffinity";
+
+	// The default command for starting the MPI workers, it can be replaced
+	// with the OSPREY_MPI_LAUNCH environment variable.
+	const char* mpiLaunchDefault = "mpiexec -n 2 ospray_mpi_worker";
+
+	OSPError initMPIOffloadDevice()
+	{
+		OSPDevice device = ospNewDevice("mpiOffload");
+		if (!device)
+			return OSP_INVALID_OPERATION;
+
+		std::string launchCommand = mpiLaunchDefault;
+		size_t envSize = 0;
+		char* envP = 0;
+		if (0 == _dupenv_s(&envP, &envSize, "OSPREY_MPI_LAUNCH") && envP)
+		{
+			launchCommand = envP;
+			free(envP);
+		}
+		ospDeviceSetParam(device, "mpiMode", OSPDataType::OSP_STRING, "mpi-launch");
+		ospDeviceSetParam(device, "launchCommand", OSPDataType::OSP_STRING, launchCommand.c_str());
+		ospDeviceCommit(device);
+		const OSPError out = ospDeviceGetLastErrorCode(device);
+		if (OSP_NO_ERROR == out)
+		{
+			ospSetCurrentDevice(device);
+		}
+		ospDeviceRelease(device);
+		return out;
+	}
+
+} // namespace
+
+COspreyPlugIn::Modules COspreyPlugIn::_loadModules(Osprey::Device device)
+{
+	Modules out;
+	if (Osprey::Device::MPIOffload == device)
+	{
+		out.mpi = ospLoadModule("mpi");
+	}
+	out.denoiserFound = ospLoadModule("denoiser") == OSP_NO_ERROR;
+	ospLoadModule("ispc");
+	return out;
+}
+
 COspreyPlugIn& OspreyPlugIn()
 {
 	return thePlugIn;
@@ -67,6 +123,8 @@ BOOL COspreyPlugIn::OnLoadPlugIn()
 {
     ASSERT(RhRdkIsAvailable());
 
+	Osprey::initLog();
+
 	ON_wString str;
 	str.Format(L"Loading %s, version %s\n", PlugInName(), PlugInVersion());
 	RhinoApp().Print(str);
@@ -85,20 +143,70 @@ BOOL COspreyPlugIn::OnLoadPlugIn()
         }
     }
 	_settings = Osprey::Settings::create();
-    const bool denoiserFound = ospLoadModule("denoiser") == OSP_NO_ERROR;
-    _settings->setDenoiserFound(denoiserFound);
-    OSPError ospError = ospInit();
-	if (ospError != OSP_NO_ERROR)
+	_loadDeviceOptions();
+
+	// The OSPRay modules are loaded in the background so that they do not
+	// slow down starting Rhino, and the device is created when it is first
+	// used by InitOSPRay().
+	_modulesFuture = std::async(std::launch::async, &COspreyPlugIn::_loadModules, _deviceOptions.device);
+
+	// The device settings can only be changed when Rhino is started, so they
+	// are saved for the next session.
+	_deviceObserver = Osprey::ValueObserver<Osprey::Device>::create(
+		_settings->observeDevice(),
+		[this](Osprey::Device)
 	{
-        Osprey::printError("Cannot initialize: " + Osprey::getErrorMessage(ospError));
-		return false;
-	}
-	OSPDevice device = ospGetCurrentDevice();
-	ospDeviceSetErrorFunc(device, Osprey::errorFunc);
-	ospDeviceSetStatusFunc(device, Osprey::messageFunc);
-	ospDeviceSetParam(device, "logLevel", OSPDataType::OSP_STRING, "debug");
-	ospDeviceCommit(device);
-	ospDeviceRelease(device);
+		_saveDeviceOptions();
+	});
+	_threadCountObserver = Osprey::ValueObserver<Osprey::ThreadCount>::create(
+		_settings->observeThreadCount(),
+		[this](Osprey::ThreadCount)
+	{
+		_saveDeviceOptions();
+	});
+	_reservedCoresObserver = Osprey::ValueObserver<Osprey::ReservedCores>::create(
+		_settings->observeReservedCores(),
+		[this](Osprey::ReservedCores)
+	{
+		_saveDeviceOptions();
+	});
+	_threadAffinityObserver = Osprey::ValueObserver<bool>::create(
+		_settings->observeThreadAffinity(),
+		[this](bool)
+	{
+		_saveDeviceOptions();
+	});
+
+	// Initialize logging.
+	_logLevelObserver = Osprey::ValueObserver<Osprey::LogLevel>::create(
+		_settings->observeLogLevel(),
+		[this](Osprey::LogLevel value)
+	{
+		Osprey::setLogLevel(value);
+		if (_ospInit)
+		{
+			OSPDevice device = ospGetCurrentDevice();
+			ospDeviceSetParam(device, "logLevel", OSPDataType::OSP_STRING, Osprey::getLogLevelValue(value).c_str());
+			ospDeviceCommit(device);
+			ospDeviceRelease(device);
+		}
+	});
+	_logFileObserver = Osprey::ValueObserver<bool>::create(
+		_settings->observeLogFile(),
+		[](bool value)
+	{
+		std::wstring fileName;
+		if (value)
+		{
+			wchar_t path[MAX_PATH];
+			if (0 == GetTempPathW(MAX_PATH, path))
+			{
+				path[0] = 0;
+			}
+			fileName = std::wstring(path) + L"Osprey.log";
+		}
+		Osprey::setLogFile(fileName);
+	});
 
 	// Initialize RDK plugin.
 	m_pRdkPlugIn = new OspreyRdkPlugIn(_settings);
@@ -153,23 +261,127 @@ BOOL COspreyPlugIn::OnLoadPlugIn()
 	return TRUE;
 }
 
+bool COspreyPlugIn::InitOSPRay()
+{
+	if (!_modulesFuture.valid())
+		return _ospInit;
+	const auto initStart = std::chrono::steady_clock::now();
+	const Modules modules = _modulesFuture.get();
+
+	OSPError ospError = OSP_NO_ERROR;
+	if (Osprey::Device::MPIOffload == _deviceOptions.device)
+	{
+		// The denoiser is only available with the local device.
+		ospError = modules.mpi;
+		if (OSP_NO_ERROR == ospError)
+		{
+			ospError = initMPIOffloadDevice();
+		}
+		if (ospError != OSP_NO_ERROR)
+		{
+			Osprey::printError("Cannot initialize the MPI offload device, using the local device: " +
+				Osprey::getErrorMessage(ospError));
+			_deviceOptions.device = Osprey::Device::Local;
+		}
+	}
+	if (Osprey::Device::Local == _deviceOptions.device)
+	{
+		_settings->setDenoiserFound(modules.denoiserFound);
+		ospError = ospInit();
+		if (ospError != OSP_NO_ERROR)
+		{
+			Osprey::printError("Cannot initialize: " + Osprey::getErrorMessage(ospError));
+			return false;
+		}
+	}
+	OSPDevice device = ospGetCurrentDevice();
+	ospDeviceSetErrorFunc(device, Osprey::errorFunc);
+	ospDeviceSetStatusFunc(device, Osprey::messageFunc);
+	ospDeviceSetParam(device, "logLevel", OSPDataType::OSP_STRING, Osprey::getLogLevelValue(Osprey::getLogLevel()).c_str());
+
+	// Leave the reserved hardware threads for the Rhino user interface and
+	// meshing threads. The OSPRay numThreads parameter only sets up the
+	// task scheduler of the thread that commits the device, and the TBB
+	// worker threads are shared by the whole process, so the limit is also
+	// applied with a TBB global control, which holds for all threads until
+	// the plug-in is unloaded.
+	int numThreads = static_cast<int>(Osprey::getThreadCountValue(_deviceOptions.threadCount));
+	const int reservedCores = static_cast<int>(Osprey::getReservedCoresValue(_deviceOptions.reservedCores));
+	const int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+	if (reservedCores > 0 && hardwareThreads > 0)
+	{
+		const int availableThreads = std::max(hardwareThreads - reservedCores, 1);
+		numThreads = numThreads > 0 ? std::min(numThreads, availableThreads) : availableThreads;
+	}
+	if (numThreads > 0)
+	{
+		ospDeviceSetParam(device, "numThreads", OSPDataType::OSP_INT, &numThreads);
+		if (Osprey::Device::Local == _deviceOptions.device)
+		{
+			_threadLimit.reset(new tbb::global_control(
+				tbb::global_control::max_allowed_parallelism,
+				static_cast<size_t>(numThreads)));
+		}
+	}
+	const bool setAffinity = _deviceOptions.threadAffinity;
+	ospDeviceSetParam(device, "setAffinity", OSPDataType::OSP_BOOL, &setAffinity);
+	ospDeviceCommit(device);
+	ospDeviceRelease(device);
+	{
+		std::stringstream ss;
+		ss << "Render threads: ";
+		if (numThreads > 0)
+		{
+			ss << numThreads;
+		}
+		else
+		{
+			ss << "automatic";
+		}
+		ss << ", thread affinity: " << (setAffinity ? "on" : "off");
+		Osprey::printMessage(ss.str());
+	}
+
+	{
+		std::stringstream ss;
+		ss << "OSPRay initialization: " <<
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - initStart).count() << " ms";
+		Osprey::printMessage(ss.str());
+	}
+
+	_ospInit = true;
+	return true;
+}
+
 void COspreyPlugIn::OnUnloadPlugIn()
 {
 	m_event_watcher.Enable(FALSE);
 	m_event_watcher.UnRegister();
 
+	_quietRender.reset();
+	_residentScene.reset();
+
+	if (_modulesFuture.valid())
+	{
+		_modulesFuture.wait();
+	}
+
 	if (nullptr != m_pRdkPlugIn)
 	{
 		m_pRdkPlugIn->Uninitialize();
 		delete m_pRdkPlugIn;
 		m_pRdkPlugIn = nullptr;
 	}
+
+	_threadLimit.reset();
+
+	Osprey::shutdownLog();
 }
 
 CRhinoCommand::result COspreyPlugIn::Render(const CRhinoCommandContext& context, bool bPreview)
 {
 	const auto rhinoDoc = context.Document();
-	if (nullptr == rhinoDoc)
+	if (nullptr == rhinoDoc || !InitOSPRay())
 		return CRhinoCommand::failure;
 
 	OspreySdkRender sdkRender(_settings, context, *this, L"Osprey", IDI_RENDER);
@@ -189,7 +401,7 @@ CRhinoCommand::result COspreyPlugIn::RenderWindow(
 	bool)
 {
     const auto rhinoDoc = context.Document();
-    if (nullptr == rhinoDoc)
+    if (nullptr == rhinoDoc || !InitOSPRay())
         return CRhinoCommand::failure;
 
 	OspreySdkRender sdkRender(_settings, context, *this, L"Osprey", IDI_RENDER);
@@ -198,14 +410,71 @@ CRhinoCommand::result COspreyPlugIn::RenderWindow(
 	return CRhinoCommand::failure;
 }
 
-CRhinoCommand::result COspreyPlugIn::RenderQuiet(const CRhinoCommandContext&, bool)
+CRhinoCommand::result COspreyPlugIn::RenderQuiet(const CRhinoCommandContext& context, bool)
 {
-	return CRhinoCommand::failure;
+	const auto rhinoDoc = context.Document();
+	const auto rhinoView = RhinoApp().ActiveView();
+	if (nullptr == rhinoDoc || nullptr == rhinoView)
+		return CRhinoCommand::failure;
+
+	const auto& view = rhinoView->ActiveViewport().View();
+	if (!RenderQuietView(*rhinoDoc, view, Osprey::QuietRender::getRenderSize(*rhinoDoc, view)))
+		return CRhinoCommand::failure;
+
+	return CRhinoCommand::success;
+}
+
+bool COspreyPlugIn::RenderQuietView(
+	const CRhinoDoc& rhinoDoc,
+	const ON_3dmView& view,
+	const ON_2iSize& size,
+	const wchar_t* fileName,
+	const std::function<bool(float)>& progress)
+{
+	if (!::RhRdkIsAvailable() || size.cx <= 0 || size.cy <= 0 || !InitOSPRay())
+		return false;
+
+	const auto residentScene = GetResidentScene(rhinoDoc, view);
+	if (!_quietRender || _quietRender->getResidentScene() != residentScene)
+	{
+		_quietRender.reset();
+		_quietRender = Osprey::QuietRender::create(residentScene);
+	}
+
+	return _quietRender->render(_settings->getOptions(), view, size, fileName ? fileName : L"", progress);
+}
+
+std::shared_ptr<Osprey::QuietRender> COspreyPlugIn::GetQuietRender() const
+{
+	return _quietRender;
+}
+
+std::shared_ptr<Osprey::ResidentScene> COspreyPlugIn::GetResidentScene(const CRhinoDoc& rhinoDoc, const ON_3dmView& view)
+{
+	// Keep the scene while the same document is rendered.
+	if (!_residentScene || _residentScene->getDocSerialNumber() != rhinoDoc.RuntimeSerialNumber())
+	{
+		_quietRender.reset();
+		_residentScene.reset();
+		_residentScene = Osprey::ResidentScene::create(rhinoDoc, view);
+	}
+	return _residentScene;
+}
+
+void COspreyPlugIn::ReleaseDocument(const CRhinoDoc& rhinoDoc)
+{
+	if (_residentScene && _residentScene->getDocSerialNumber() == rhinoDoc.RuntimeSerialNumber())
+	{
+		_quietRender.reset();
+		_residentScene.reset();
+	}
 }
 
 BOOL COspreyPlugIn::SaveRenderedImage(ON_wString filename)
 {
-	return FALSE;
+	if (!_quietRender)
+		return FALSE;
+	return _quietRender->save(filename) ? TRUE : FALSE;
 }
 
 BOOL COspreyPlugIn::CloseRenderWindow()
@@ -238,3 +507,44 @@ void COspreyPlugIn::SetLightingChanged(BOOL bChanged)
 {
 	m_event_watcher.SetLightFlags(bChanged);
 }
+
+void COspreyPlugIn::_loadDeviceOptions()
+{
+	int value = 0;
+	if (GetProfileInt(profileSection, profileDevice, &value) &&
+		value >= 0 && value < static_cast<int>(Osprey::Device::Count))
+	{
+		_deviceOptions.device = static_cast<Osprey::Device>(value);
+	}
+	if (GetProfileInt(profileSection, profileThreadCount, &value) &&
+		value >= 0 && value < static_cast<int>(Osprey::ThreadCount::Count))
+	{
+		_deviceOptions.threadCount = static_cast<Osprey::ThreadCount>(value);
+	}
+	if (GetProfileInt(profileSection, profileReservedCores, &value) &&
+		value >= 0 && value < static_cast<int>(Osprey::ReservedCores::Count))
+	{
+		_deviceOptions.reservedCores = static_cast<Osprey::ReservedCores>(value);
+	}
+	if (GetProfileInt(profileSection, profileThreadAffinity, &value))
+	{
+		_deviceOptions.threadAffinity = value != 0;
+	}
+	_settings->setDevice(_deviceOptions.device);
+	_settings->setThreadCount(_deviceOptions.threadCount);
+	_settings->setReservedCores(_deviceOptions.reservedCores);
+	_settings->setThreadAffinity(_deviceOptions.threadAffinity);
+}
+
+void COspreyPlugIn::_saveDeviceOptions()
+{
+	const Osprey::DeviceOptions deviceOptions = _settings->getDeviceOptions();
+	SaveProfileInt(profileSection, profileDevice, static_cast<int>(deviceOptions.device));
+	SaveProfileInt(profileSection, profileThreadCount, static_cast<int>(deviceOptions.threadCount));
+	SaveProfileInt(profileSection, profileReservedCores, static_cast<int>(deviceOptions.reservedCores));
+	SaveProfileInt(profileSection, profileThreadAffinity, deviceOptions.threadAffinity ? 1 : 0);
+	if (deviceOptions != _deviceOptions)
+	{
+		Osprey::printMessage("The device settings will be changed when Rhino is restarted");
+	}
+}
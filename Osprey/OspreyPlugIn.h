@@ -3,12 +3,16 @@
 
 #pragma once
 
+#include "OspreyData.h"
 #include "OspreyEventWatcher.h"
+#include "OspreyValueObserver.h"
 
 class OspreyRdkPlugIn;
 
 namespace Osprey
 {
+    class QuietRender;
+    class ResidentScene;
     class Settings;
 
 } // namespace Osprey
@@ -37,6 +41,12 @@ public:
 	BOOL SaveRenderedImage(ON_wString filename) override;
 	BOOL CloseRenderWindow() override;
 
+	//! Initialize OSPRay. The OSPRay modules are loaded in the background
+	//! when the plug-in loads, and the device is created the first time this
+	//! is called. It must be called before OSPRay is used. Returns false if
+	//! OSPRay could not be initialized.
+	bool InitOSPRay();
+
 	CRhinoCommand::result RenderQuiet(const CRhinoCommandContext&, bool bPreview);
 	BOOL SceneChanged() const;
 	void SetSceneChanged(BOOL bChanged);
@@ -44,8 +54,53 @@ public:
 	void SetLightingChanged(BOOL bChanged);
 	UINT MainFrameResourceID() const;
 
+	//! Render a view of a document without any user interface. The resident
+	//! scene of the document is used, use
+	//! SaveRenderedImage() to write the result. OpenEXR images are written
+	//! while rendering if the file name is given. The render is cancelled if
+	//! the progress callback returns false.
+	bool RenderQuietView(
+		const CRhinoDoc&,
+		const ON_3dmView&,
+		const ON_2iSize&,
+		const wchar_t* fileName = nullptr,
+		const std::function<bool(float)>& progress = nullptr);
+
+	//! Get the quiet render of the last RenderQuietView() call.
+	std::shared_ptr<Osprey::QuietRender> GetQuietRender() const;
+
+	//! Get the resident scene of a document. The scene is kept between the
+	//! renders of the same document, so that only the document changes are
+	//! applied for each render.
+	std::shared_ptr<Osprey::ResidentScene> GetResidentScene(const CRhinoDoc&, const ON_3dmView&);
+
+	//! Release the resident scene and quiet render of a document.
+	void ReleaseDocument(const CRhinoDoc&);
+
 private:
+	struct Modules
+	{
+		OSPError mpi = OSP_NO_ERROR;
+		bool denoiserFound = false;
+	};
+
+	static Modules _loadModules(Osprey::Device);
+	void _loadDeviceOptions();
+	void _saveDeviceOptions();
+
     std::shared_ptr<Osprey::Settings> _settings;
+    Osprey::DeviceOptions _deviceOptions;
+    std::future<Modules> _modulesFuture;
+    bool _ospInit = false;
+    std::unique_ptr<tbb::global_control> _threadLimit;
+    std::shared_ptr<Osprey::ValueObserver<Osprey::Device> > _deviceObserver;
+    std::shared_ptr<Osprey::ValueObserver<Osprey::ThreadCount> > _threadCountObserver;
+    std::shared_ptr<Osprey::ValueObserver<Osprey::ReservedCores> > _reservedCoresObserver;
+    std::shared_ptr<Osprey::ValueObserver<bool> > _threadAffinityObserver;
+    std::shared_ptr<Osprey::ValueObserver<Osprey::LogLevel> > _logLevelObserver;
+    std::shared_ptr<Osprey::ValueObserver<bool> > _logFileObserver;
+    std::shared_ptr<Osprey::ResidentScene> _residentScene;
+    std::shared_ptr<Osprey::QuietRender> _quietRender;
     ON_wString m_plugin_version;
 	COspreyEventWatcher m_event_watcher;
 	OspreyRdkPlugIn* m_pRdkPlugIn;
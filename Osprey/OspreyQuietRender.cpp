@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#include "stdafx.h"
+#include "OspreyImageIO.h"
+#include "OspreyPlugIn.h"
+#include "OspreyQuietRender.h"
+#include "OspreyRender.h"
+#include "OspreyResidentScene.h"
+#include "OspreyUtil.h"
+
+namespace Osprey
+{
+    QuietRender::QuietRender()
+    {}
+
+    QuietRender::~QuietRender()
+    {
+        waitSave();
+    }
+
+    std::shared_ptr<QuietRender> QuietRender::create(const std::shared_ptr<ResidentScene>& residentScene)
+    {
+        auto out = std::shared_ptr<QuietRender>(new QuietRender);
+        out->_residentScene = residentScene;
+
+        out->_render = Render::create();
+
+        for (auto& i : out->_rdkRenderWindows)
+        {
+            i.reset(IRhRdkRenderWindow::New());
+            i->ClearChannels();
+            i->AddChannel(IRhRdkRenderWindow::chanDistanceFromCamera, sizeof(float));
+            i->AddChannel(IRhRdkRenderWindow::chanNormalX, sizeof(float));
+            i->AddChannel(IRhRdkRenderWindow::chanNormalY, sizeof(float));
+            i->AddChannel(IRhRdkRenderWindow::chanNormalZ, sizeof(float));
+        }
+
+        return out;
+    }
+
+    const std::shared_ptr<ResidentScene>& QuietRender::getResidentScene() const
+    {
+        return _residentScene;
+    }
+
+    bool QuietRender::render(
+        const Options& options,
+        const ON_3dmView& view,
+        const ON_2iSize& renderSize,
+        const std::wstring& fileName,
+        const std::function<bool(float)>& progress)
+    {
+        const auto renderStart = std::chrono::steady_clock::now();
+
+        // Render into the other window, waiting if it is still being saved.
+        const size_t next = 1 - _current;
+        if (_saveThread.joinable() && _saveIndex == next)
+        {
+            waitSave();
+        }
+        _current = next;
+        auto& rdkRenderWindow = *_rdkRenderWindows[_current];
+        _rendered = false;
+        _fileName.clear();
+
+        // Apply the changes since the last render.
+        _residentScene->update(options, view);
+        const auto& scene = _residentScene->getScene();
+
+        rdkRenderWindow.SetSize(renderSize);
+        rdkRenderWindow.EnsureDib();
+
+        // Split the image into buckets the same as the final render so that
+        // large images stay within the available memory.
+        const ospcommon::math::box2i renderRect(
+            ospcommon::math::vec2i(0, 0),
+            ospcommon::math::vec2i(renderSize.cx, renderSize.cy));
+        size_t bucketSize = getBucketSizeValue(options.bucketSize);
+        if (BucketSize::Automatic == options.bucketSize)
+        {
+            bucketSize = Render::getAutoBucketSize(renderRect.size());
+        }
+        const auto buckets = Render::getBuckets(renderRect, bucketSize);
+
+        // There is nobody to look at the preview passes.
+        Options renderOptions = options;
+        renderOptions.previewPasses = 0;
+        renderOptions.flipY = true;
+
+        // OpenEXR images are written as tiles when each bucket finishes,
+        // straight from the frame buffer. The other formats are saved from
+        // the DIB.
+        std::shared_ptr<EXRWriter> exrWriter;
+        if (isEXRFileName(fileName))
+        {
+            exrWriter = EXRWriter::create(fileName, fromRhino(renderSize), { "R", "G", "B", "A", "Z" });
+            if (!exrWriter)
+                return false;
+        }
+        CRhinoDib& dib = _dibs[_current];
+        if (!dib.CreateDib(renderSize.cx, renderSize.cy, 32, true))
+            return false;
+        const float gamma = scene->gamma;
+        _render->setImageCallback([exrWriter, &dib, gamma](
+            const ospcommon::math::box2i& rect,
+            const float* color,
+            const float* depth,
+            const float*,
+            bool flipY)
+        {
+            if (exrWriter)
+            {
+                exrWriter->writeTiles(
+                    rect,
+                    { { color, 4 }, { color + 1, 4 }, { color + 2, 4 }, { color + 3, 4 }, { depth, 1 } },
+                    flipY);
+            }
+            Render::copyToDib(rect, color, flipY, gamma, dib);
+        });
+
+        scene->renderSize = fromRhino(renderSize);
+        const size_t totalPasses = buckets.size() * renderOptions.passes;
+        size_t pass = 0;
+        bool cancelled = false;
+        for (size_t i = 0; i < buckets.size() && !cancelled; ++i)
+        {
+            scene->renderRect = buckets[i];
+            scene->windowOffset = buckets[i].lower;
+            _render->init(renderOptions, scene);
+
+            for (size_t j = 0; j < renderOptions.passes && !cancelled; ++j, ++pass)
+            {
+                std::function<bool(float)> passProgress;
+                if (progress)
+                {
+                    passProgress = [&](float value)
+                    {
+                        return progress((pass + value) / static_cast<float>(totalPasses));
+                    };
+                }
+                cancelled = !_render->render(j, rdkRenderWindow, passProgress);
+            }
+        }
+        rdkRenderWindow.Invalidate();
+        _render->setImageCallback(nullptr);
+
+        if (exrWriter)
+        {
+            const bool written = exrWriter->close() && !cancelled;
+            exrWriter.reset();
+            if (!written)
+            {
+                _wremove(fileName.c_str());
+                return false;
+            }
+            _fileName = fileName;
+        }
+        if (cancelled)
+            return false;
+        _rendered = true;
+
+        std::stringstream ss;
+        ss << "Quiet render: " << buckets.size() << " buckets, " << totalPasses << " passes, " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - renderStart).count() << " ms";
+        printMessage(ss.str());
+
+        return true;
+    }
+
+    IRhRdkRenderWindow& QuietRender::getRenderWindow()
+    {
+        return *_rdkRenderWindows[_current];
+    }
+
+    bool QuietRender::save(const wchar_t* fileName) const
+    {
+        if (!_rendered)
+            return false;
+        if (!_fileName.empty() && 0 == _wcsicmp(fileName, _fileName.c_str()))
+            return true;
+        return _rdkRenderWindows[_current]->SaveRenderImageAs(fileName, ::OspreyPlugIn().PlugInID(), false);
+    }
+
+    void QuietRender::saveAsync(const std::wstring& fileName)
+    {
+        waitSave();
+        if (!_rendered)
+        {
+            _saveResult = false;
+            return;
+        }
+        if (!_fileName.empty() && 0 == _wcsicmp(fileName.c_str(), _fileName.c_str()))
+        {
+            _saveResult = true;
+            return;
+        }
+
+        // Only the DIB is used in the background thread, the render window
+        // can only be used from the UI thread.
+        _saveIndex = _current;
+        _saveThread = std::thread([this, fileName]
+        {
+            const auto saveStart = std::chrono::steady_clock::now();
+            _saveResult = _dibs[_saveIndex].WriteToFile(fileName.c_str());
+
+            std::stringstream ss;
+            ss << "Quiet render save: " <<
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - saveStart).count() << " ms";
+            printMessage(ss.str());
+        });
+    }
+
+    bool QuietRender::waitSave()
+    {
+        if (_saveThread.joinable())
+        {
+            _saveThread.join();
+        }
+        return _saveResult;
+    }
+
+    ON_2iSize QuietRender::getRenderSize(const CRhinoDoc& rhinoDoc, const ON_3dmView& view)
+    {
+        const auto& renderSettings = rhinoDoc.Properties().RenderSettings();
+        if (renderSettings.m_bCustomImageSize)
+            return ON_2iSize(renderSettings.m_image_width, renderSettings.m_image_height);
+
+        int left = 0;
+        int right = 0;
+        int bottom = 0;
+        int top = 0;
+        view.m_vp.GetScreenPort(&left, &right, &bottom, &top);
+        return ON_2iSize(std::abs(right - left), std::abs(top - bottom));
+    }
+
+} // namespace Osprey
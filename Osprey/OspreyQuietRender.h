@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#pragma once
+
+#include "OspreyData.h"
+
+namespace Osprey
+{
+    class Render;
+    class ResidentScene;
+
+    //! This class provides rendering without any user interface for scripts
+    //! and batch jobs. The scene is shared with the other renders of the
+    //! document, so that consecutive renders only pay for the scene changes
+    //! instead of building the whole scene each time.
+    //!
+    //! There are two render windows that are used in turn, so that an image
+    //! can be saved in the background while the next one renders. The image
+    //! is also copied to a DIB while it renders, so that the background save
+    //! only encodes the DIB and never calls the render window.
+    class QuietRender
+    {
+        QuietRender();
+        QuietRender(const QuietRender&) = delete;
+        QuietRender& operator = (const QuietRender&) = delete;
+
+    public:
+        ~QuietRender();
+
+        // Create a new instance.
+        static std::shared_ptr<QuietRender> create(const std::shared_ptr<ResidentScene>&);
+
+        //! Get the resident scene.
+        const std::shared_ptr<ResidentScene>& getResidentScene() const;
+
+        //! Render a view. If an OpenEXR file name is given the image is
+        //! written to the file while it renders. The optional callback is
+        //! called with the progress of the render, and the render is
+        //! cancelled if it returns false. Returns false if the render was
+        //! cancelled or the file could not be written.
+        bool render(
+            const Options&,
+            const ON_3dmView&,
+            const ON_2iSize&,
+            const std::wstring& fileName = std::wstring(),
+            const std::function<bool(float)>& progress = nullptr);
+
+        //! Get the render window containing the last rendered image.
+        IRhRdkRenderWindow& getRenderWindow();
+
+        //! Save the last rendered image. Nothing is done if the image was
+        //! already written to the file while rendering.
+        bool save(const wchar_t* fileName) const;
+
+        //! Save the last rendered image in a background thread. This waits
+        //! for the previous background save to finish first.
+        void saveAsync(const std::wstring& fileName);
+
+        //! Wait for the background save to finish. Returns false if the save
+        //! failed.
+        bool waitSave();
+
+        //! Get the render size for a view, either the custom size from the
+        //! document render settings or the size of the viewport.
+        static ON_2iSize getRenderSize(const CRhinoDoc&, const ON_3dmView&);
+
+    private:
+        std::shared_ptr<ResidentScene> _residentScene;
+        std::shared_ptr<Render> _render;
+        std::unique_ptr<IRhRdkRenderWindow> _rdkRenderWindows[2];
+        CRhinoDib _dibs[2];
+        size_t _current = 0;
+        bool _rendered = false;
+        std::wstring _fileName;
+        std::thread _saveThread;
+        size_t _saveIndex = 0;
+        bool _saveResult = true;
+    };
+
+} // namespace Osprey
@@ -7,6 +7,111 @@
 
 namespace Osprey
 {
+    namespace
+    {
+        // The approximate frame buffer memory per pixel, including the
+        // channels, the temporary copy and the image operations.
+        const uint64_t frameBufferPixelBytes = 128;
+
+        // The smallest automatic bucket size.
+        const size_t bucketSizeMin = 64;
+
+        // How often the progress callback is called while rendering.
+        const std::chrono::milliseconds progressInterval(10);
+
+        // The default parameters of the OSPRay tone mapper.
+        const float toneMapContrast = 1.6773F;
+        const float toneMapShoulder = 0.9714F;
+        const float toneMapMidIn = 0.18F;
+        const float toneMapMidOut = 0.18F;
+        const float toneMapHDRMax = 11.0785F;
+
+        // The ACES color transforms used by the OSPRay tone mapper.
+        const float acesInput[3][3] =
+        {
+            { 0.59719F, 0.35458F, 0.04823F },
+            { 0.07600F, 0.90834F, 0.01566F },
+            { 0.02840F, 0.13383F, 0.83777F }
+        };
+        const float acesOutput[3][3] =
+        {
+            {  1.60475F, -0.53108F, -0.07367F },
+            { -0.10208F,  1.10813F, -0.00605F },
+            { -0.00327F, -0.07276F,  1.07602F }
+        };
+
+        //! The tone mapping curve for an exposure. This matches the OSPRay
+        //! tone mapper operation with the default parameters, using the
+        //! filmic curve from "Advanced Techniques and Optimization of HDR
+        //! Color Pipelines", Timothy Lottes.
+        class ToneMapCurve
+        {
+        public:
+            explicit ToneMapCurve(float exposure) :
+                _exposure(exposure)
+            {
+                _a = toneMapContrast;
+                _ad = toneMapContrast * toneMapShoulder;
+                const float hdrMaxA = powf(toneMapHDRMax, _a);
+                const float hdrMaxAD = powf(toneMapHDRMax, _ad);
+                const float midInA = powf(toneMapMidIn, _a);
+                const float midInAD = powf(toneMapMidIn, _ad);
+                _b = (-midInA + hdrMaxA * toneMapMidOut) / ((hdrMaxAD - midInAD) * toneMapMidOut);
+                _c = (hdrMaxAD * midInA - hdrMaxA * midInAD * toneMapMidOut) / ((hdrMaxAD - midInAD) * toneMapMidOut);
+            }
+
+            //! Apply the curve to RGBA pixels.
+            void apply(const float* in, float* out, size_t pixels) const
+            {
+                for (size_t i = 0; i < pixels; ++i, in += 4, out += 4)
+                {
+                    float x[3];
+                    for (size_t j = 0; j < 3; ++j)
+                    {
+                        const float v =
+                            acesInput[j][0] * in[0] +
+                            acesInput[j][1] * in[1] +
+                            acesInput[j][2] * in[2];
+                        const float e = std::max(v * _exposure, 0.F);
+                        x[j] = powf(e, _a) / (powf(e, _ad) * _b + _c);
+                    }
+                    for (size_t j = 0; j < 3; ++j)
+                    {
+                        const float v =
+                            acesOutput[j][0] * x[0] +
+                            acesOutput[j][1] * x[1] +
+                            acesOutput[j][2] * x[2];
+                        out[j] = std::min(std::max(v, 0.F), 1.F);
+                    }
+                    out[3] = in[3];
+                }
+            }
+
+        private:
+            float _exposure = 1.F;
+            float _a = 0.F;
+            float _ad = 0.F;
+            float _b = 0.F;
+            float _c = 0.F;
+        };
+
+        // The size of the table for converting linear values to 8-bit.
+        const size_t gammaTableSize = 16384;
+
+        std::vector<uint8_t> getGammaTable(float gamma)
+        {
+            std::vector<uint8_t> out(gammaTableSize);
+            const float e = gamma > 0.F ? 1.F / gamma : 1.F;
+            for (size_t i = 0; i < gammaTableSize; ++i)
+            {
+                const float v = powf(i / static_cast<float>(gammaTableSize - 1), e);
+                out[i] = static_cast<uint8_t>(std::min(std::max(v * 255.F + .5F, 0.F), 255.F));
+            }
+            return out;
+        }
+
+    } // namespace
+
     Render::Render()
     {}
 
@@ -23,12 +128,13 @@ namespace Osprey
             _renderer.setParam("maxPathLength", 1);
         }
 
+        // The tone mapping is applied when the image is copied to Rhino, and
+        // the denoiser is set on the frame buffers for each pass, so neither
+        // needs new frame buffers.
         if (options.previewPasses != _options.previewPasses ||
             options.denoiserFound != _options.denoiserFound ||
-            options.denoiserEnabled != _options.denoiserEnabled ||
-            options.toneMapperEnabled != _options.toneMapperEnabled ||
-            options.toneMapperExposure != _options.toneMapperExposure ||
             options.flipY != _options.flipY ||
+            !_scene ||
             scene->renderSize != _scene->renderSize)
         {
             _frameBufferSize = ospcommon::math::vec2i(0, 0);
@@ -36,6 +142,8 @@ namespace Osprey
 
         _options = options;
         _scene = scene;
+        _imageValid = false;
+        _denoiseTime = std::chrono::steady_clock::now();
 
 		_renderer.setParam("pixelSamples", static_cast<int>(_options.pixelSamples));
 		_renderer.setParam("aoSamples", static_cast<int>(_options.aoSamples));
@@ -45,7 +153,10 @@ namespace Osprey
         _initFrameBuffers(_scene->renderRect.size());
     }
 
-	void Render::render(size_t pass, IRhRdkRenderWindow& rdkRenderWindow)
+	bool Render::render(
+        size_t pass,
+        IRhRdkRenderWindow& rdkRenderWindow,
+        const std::function<bool(float)>& progress)
 	{
         if (_scene->renderSize.x > 0 && _scene->renderSize.y > 0)
         {
@@ -61,106 +172,194 @@ namespace Osprey
             _scene->camera.setParam("imageEnd", imageEnd);
             _scene->camera.commit();
 
-		    // Render a frame.
+		    // Render a frame. The frame is rendered asynchronously so that it
+            // can be cancelled part way through, which also abandons the
+            // image operations like the denoiser.
             size_t index = std::min(pass, _frameBuffers.size() - 1);
-            _frameBuffers[index].renderFrame(_renderer, _scene->camera, _scene->world);
+            const bool denoise = _isDenoisePass(pass);
+            _setDenoiser(index, denoise);
+            OSPFuture future = ospRenderFrame(
+                _frameBuffers[index].handle(),
+                _renderer.handle(),
+                _scene->camera.handle(),
+                _scene->world.handle());
+            bool cancelled = false;
+            if (progress)
+            {
+                while (!ospIsReady(future, OSP_TASK_FINISHED))
+                {
+                    if (!progress(ospGetProgress(future)))
+                    {
+                        ospCancel(future);
+                        ospWait(future, OSP_TASK_FINISHED);
+                        cancelled = true;
+                        break;
+                    }
+                    std::this_thread::sleep_for(progressInterval);
+                }
+            }
+            else
+            {
+                ospWait(future, OSP_TASK_FINISHED);
+            }
+            ospRelease(future);
+            if (cancelled)
+                return false;
+            if (denoise)
+            {
+                _denoiseTime = std::chrono::steady_clock::now();
+            }
 
-		    // Copy the RGBA channels to Rhino.
 		    const ospcommon::math::vec2i renderSize = _scene->renderRect.size();
-		    IRhRdkRenderWindow::IChannel* pChanRGBA = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanRGBA);
-		    if (pChanRGBA)
-		    {
-			    void* fb = _frameBuffers[index].map(OSP_FB_COLOR);
-			    float* fbP = reinterpret_cast<float*>(fb);
+            _imageIndex = index;
+            _imageValid = true;
+            if (_viewportImage)
+            {
+                // The viewport image is converted straight from the frame
+                // buffer. The frame buffer keeps the image until the next
+                // pass, so the tone mapping can be applied again from it.
+                _copyViewport(index);
+            }
+            else
+            {
+                // Copy the color to the temporary buffer, which is kept so
+                // that the tone mapping can be changed without rendering
+                // again.
+                _frameBufferTemp.resize(renderSize.x * renderSize.y * 4);
+                void* fb = _frameBuffers[index].map(OSP_FB_COLOR);
+                const float* fbP = reinterpret_cast<const float*>(fb);
                 const size_t scale = renderSize.x / _frameBuffersSizes[index].x;
                 if (scale > 1)
                 {
                     _scale(fbP, _frameBuffersSizes[index], _frameBufferTemp.data(), renderSize, scale, _options.flipY);
-                    pChanRGBA->SetValueRect(
-                        0,
-                        0,
-                        renderSize.x,
-                        renderSize.y,
-                        renderSize.x * 4 * sizeof(float),
-                        ComponentOrder::RGBA,
-                        _frameBufferTemp.data());
                 }
                 else if (_options.flipY)
                 {
-                    _flipImage(fbP, _frameBufferTemp.data(), _frameBuffersSizes[index]);
-                    pChanRGBA->SetValueRect(
-                        0,
-                        0,
-                        renderSize.x,
-                        renderSize.y,
-                        renderSize.x * 4 * sizeof(float),
-                        ComponentOrder::RGBA,
-                        _frameBufferTemp.data());
+                    _flipImage(fbP, _frameBufferTemp.data(), _frameBuffersSizes[index], 4);
                 }
                 else
                 {
-                    pChanRGBA->SetValueRect(
-                        0,
-                        0,
-                        _frameBuffersSizes[index].x,
-                        _frameBuffersSizes[index].y,
-                        _frameBuffersSizes[index].x * 4 * sizeof(float),
-                        ComponentOrder::RGBA,
-                        fbP);
+                    memcpy(_frameBufferTemp.data(), fbP, renderSize.x * renderSize.y * 4 * sizeof(float));
+                }
+                _frameBuffers[index].unmap(fb);
+
+                // Copy the RGBA channels to Rhino.
+                _copyColor(rdkRenderWindow);
+            }
+
+		    // Copy the depth and normal channels to Rhino. These are only
+            // copied from the full resolution passes.
+            if (_frameBuffersSizes[index] == renderSize)
+            {
+                if (!_viewportImage)
+                {
+                    _copyDepth(rdkRenderWindow, _frameBuffers[index]);
+                    _copyNormals(rdkRenderWindow, _frameBuffers[index]);
+                }
+
+                if (_imageCallback && pass + 1 >= _options.previewPasses + _options.passes)
+                {
+                    _callImageCallback(_frameBuffers[index]);
                 }
-			    _frameBuffers[index].unmap(fb);
-			    pChanRGBA->Close();
-		    }
-
-		    // Copy the depth channel to Rhino.
-		    /*IRhRdkRenderWindow::IChannel* pChanDepth = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanDistanceFromCamera);
-		    if (pChanDepth)
-		    {
-			    void* fb = _frameBuffer.map(OSP_FB_DEPTH);
-			    float* fbP = reinterpret_cast<float*>(fb);
-			    for (int y = 0; y < renderSize.y; ++y)
-			    {
-				    for (int x = 0; x < renderSize.x; ++x)
-				    {
-					    pChanDepth->SetValue(x, renderSize.y - 1 - y, ComponentOrder::Irrelevant, fbP);
-					    ++fbP;
-				    }
-			    }
-			    _frameBuffer.unmap(fb);
-			    pChanDepth->Close();
-		    }*/
-
-		    // Copy the normal channels to Rhino.
-		    /*IRhRdkRenderWindow::IChannel* pChanNormalX = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanNormalX);
-		    IRhRdkRenderWindow::IChannel* pChanNormalY = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanNormalY);
-		    IRhRdkRenderWindow::IChannel* pChanNormalZ = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanNormalZ);
-		    if (pChanNormalX && pChanNormalY && pChanNormalZ)
-		    {
-			    void* fb = _frameBuffer.map(OSP_FB_NORMAL);
-			    float* fbP = reinterpret_cast<float*>(fb);
-			    for (int y = 0; y < renderSize.y; ++y)
-			    {
-				    for (int x = 0; x < renderSize.x; ++x)
-				    {
-					    pChanNormalX->SetValue(x, renderSize.y - 1 - y, ComponentOrder::Irrelevant, fbP);
-					    ++fbP;
-					    pChanNormalY->SetValue(x, renderSize.y - 1 - y, ComponentOrder::Irrelevant, fbP);
-					    ++fbP;
-					    pChanNormalZ->SetValue(x, renderSize.y - 1 - y, ComponentOrder::Irrelevant, fbP);
-					    ++fbP;
-				    }
-			    }
-			    _frameBuffer.unmap(fb);
-		    }
-		    if (pChanNormalX || pChanNormalY || pChanNormalZ)
-		    {
-			    pChanNormalX->Close();
-			    pChanNormalY->Close();
-			    pChanNormalZ->Close();
-		    }*/
+            }
 
 		    rdkRenderWindow.Invalidate();
         }
+        return true;
+    }
+
+    bool Render::isPostProcessChange(const Options& a, const Options& b)
+    {
+        Options tmp = a;
+        tmp.denoiserEnabled = b.denoiserEnabled;
+        tmp.denoiserInterval = b.denoiserInterval;
+        tmp.denoisePreviews = b.denoisePreviews;
+        tmp.toneMapperEnabled = b.toneMapperEnabled;
+        tmp.toneMapperExposure = b.toneMapperExposure;
+        return tmp == b && a != b;
+    }
+
+    bool Render::setPostProcess(const Options& options)
+    {
+        const bool out = options.denoiserEnabled != _options.denoiserEnabled && _options.denoiserFound;
+        _options.denoiserEnabled = options.denoiserEnabled;
+        _options.denoiserInterval = options.denoiserInterval;
+        _options.denoisePreviews = options.denoisePreviews;
+        _options.toneMapperEnabled = options.toneMapperEnabled;
+        _options.toneMapperExposure = options.toneMapperExposure;
+        return out;
+    }
+
+    void Render::updateImage(IRhRdkRenderWindow& rdkRenderWindow)
+    {
+        if (_imageValid)
+        {
+            if (_viewportImage)
+            {
+                _copyViewport(_imageIndex);
+            }
+            else
+            {
+                _copyColor(rdkRenderWindow);
+            }
+            rdkRenderWindow.Invalidate();
+        }
+    }
+
+    void Render::setImageCallback(const ImageCallback& value)
+    {
+        _imageCallback = value;
+    }
+
+    void Render::setViewportImage(const std::shared_ptr<ViewportImage>& value)
+    {
+        _viewportImage = value;
+    }
+
+    float Render::getVariance() const
+    {
+        return _frameBuffers.size() > 0 ? ospGetVariance(_frameBuffers.back().handle()) : 0.F;
+    }
+
+    std::vector<ospcommon::math::box2i> Render::getBuckets(const ospcommon::math::box2i& rect, size_t bucketSize)
+    {
+        std::vector<ospcommon::math::box2i> out;
+        const ospcommon::math::vec2i size = rect.size();
+        const int b = static_cast<int>(bucketSize);
+        if (0 == b || (size.x <= b && size.y <= b))
+        {
+            out.push_back(rect);
+            return out;
+        }
+        for (int y = rect.lower.y; y < rect.upper.y; y += b)
+        {
+            for (int x = rect.lower.x; x < rect.upper.x; x += b)
+            {
+                out.push_back(ospcommon::math::box2i(
+                    ospcommon::math::vec2i(x, y),
+                    ospcommon::math::vec2i(std::min(x + b, rect.upper.x), std::min(y + b, rect.upper.y))));
+            }
+        }
+        return out;
+    }
+
+    size_t Render::getAutoBucketSize(const ospcommon::math::vec2i& size)
+    {
+        // Keep the frame buffers within a quarter of the available physical
+        // memory.
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+        if (!GlobalMemoryStatusEx(&status))
+            return 0;
+        const uint64_t pixels = status.ullAvailPhys / 4 / frameBufferPixelBytes;
+        if (static_cast<uint64_t>(size.x) * static_cast<uint64_t>(size.y) <= pixels)
+            return 0;
+        size_t out = bucketSizeMin;
+        while (static_cast<uint64_t>(out * 2) * static_cast<uint64_t>(out * 2) <= pixels)
+        {
+            out *= 2;
+        }
+        return out;
     }
 
     void Render::_initFrameBuffers(const ospcommon::math::vec2i& size)
@@ -186,41 +385,271 @@ namespace Osprey
                 OSP_FB_RGBA32F,
                 OSP_FB_COLOR | OSP_FB_DEPTH | OSP_FB_ACCUM | OSP_FB_VARIANCE | OSP_FB_NORMAL | OSP_FB_ALBEDO);
             _frameBuffersSizes[i] = frameBufferSize;
+            _frameBuffers[i].commit();
+        }
+        _frameBuffersDenoiser = std::vector<bool>(totalPasses, false);
+    }
+
+    bool Render::_isDenoisePass(size_t pass) const
+    {
+        if (!_options.denoiserFound || !_options.denoiserEnabled)
+            return false;
+
+        // The preview passes are denoised at their lower resolution.
+        if (pass < _options.previewPasses)
+            return _options.denoisePreviews;
 
+        // The last pass is always denoised.
+        if (pass + 1 >= _options.previewPasses + _options.passes)
+            return true;
+
+        if (const size_t passes = getDenoiserIntervalPasses(_options.denoiserInterval))
+            return 0 == (pass - _options.previewPasses + 1) % passes;
+        const std::chrono::milliseconds time = getDenoiserIntervalTime(_options.denoiserInterval);
+        return time.count() > 0 && std::chrono::steady_clock::now() - _denoiseTime >= time;
+    }
+
+    void Render::_setDenoiser(size_t index, bool value)
+    {
+        // Committing the frame buffer does not clear the accumulation, so the
+        // denoiser can be added and removed between passes.
+        if (value == _frameBuffersDenoiser[index])
+            return;
+        _frameBuffersDenoiser[index] = value;
+        if (value)
+        {
+            ospray::cpp::ImageOperation denoiser("denoiser");
+            denoiser.commit();
             std::vector<ospray::cpp::ImageOperation> imageOps;
-            if (_options.toneMapperEnabled)
+            imageOps.emplace_back(denoiser);
+            _frameBuffers[index].setParam("imageOperation", ospray::cpp::Data(imageOps));
+        }
+        else
+        {
+            _frameBuffers[index].removeParam("imageOperation");
+        }
+        _frameBuffers[index].commit();
+    }
+
+    void Render::_copyColor(IRhRdkRenderWindow& rdkRenderWindow)
+    {
+        const ospcommon::math::vec2i size = _scene->renderRect.size();
+        const float* p = _frameBufferTemp.data();
+        if (_options.toneMapperEnabled)
+        {
+            _toneMapTemp.resize(_frameBufferTemp.size());
+            _toneMap(p, _toneMapTemp.data(), size.x * size.y, _options.toneMapperExposure);
+            p = _toneMapTemp.data();
+        }
+        IRhRdkRenderWindow::IChannel* pChanRGBA = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanRGBA);
+        if (pChanRGBA)
+        {
+            pChanRGBA->SetValueRect(
+                _scene->windowOffset.x,
+                _scene->windowOffset.y,
+                size.x,
+                size.y,
+                size.x * 4 * sizeof(float),
+                ComponentOrder::RGBA,
+                p);
+            pChanRGBA->Close();
+        }
+    }
+
+    void Render::_copyViewport(size_t index)
+    {
+        const ospcommon::math::vec2i size = _scene->renderRect.size();
+        std::lock_guard<std::mutex> lock(_viewportImage->mutex);
+        CRhinoDib& dib = _viewportImage->dib;
+        if (dib.Width() != size.x || dib.Height() != size.y || dib.BitsPerPixel() != 32)
+            return;
+
+        // The viewport image is drawn as is, so the gamma that Rhino applies
+        // to the render window is applied here.
+        if (_scene->gamma != _gammaTableValue || _gammaTable.empty())
+        {
+            _gammaTableValue = _scene->gamma;
+            _gammaTable = getGammaTable(_gammaTableValue);
+        }
+
+        // Each row is scaled up from the preview passes and tone mapped in a
+        // small buffer, and then converted to 8-bit. The DIB rows are
+        // ordered from bottom to top, matching the render window DIB.
+        const ospcommon::math::vec2i& inSize = _frameBuffersSizes[index];
+        const int scale = std::max(size.x / inSize.x, 1);
+        const bool flipY = _options.flipY;
+        std::unique_ptr<ToneMapCurve> toneMap;
+        if (_options.toneMapperEnabled)
+        {
+            toneMap.reset(new ToneMapCurve(_options.toneMapperExposure));
+        }
+        uint8_t* bits = reinterpret_cast<uint8_t*>(dib.FindDIBBits());
+        const size_t scanSize = dib.SizeofScan();
+        const uint8_t* table = _gammaTable.data();
+        void* fb = _frameBuffers[index].map(OSP_FB_COLOR);
+        const float* in = reinterpret_cast<const float*>(fb);
+        tbb::parallel_for(tbb::blocked_range<int>(0, size.y), [&](const tbb::blocked_range<int>& r)
+        {
+            std::vector<float> scaleRow;
+            std::vector<float> toneMapRow;
+            for (int y = r.begin(); y != r.end(); ++y)
             {
-                // Add the tone mapper operation.
-                ospray::cpp::ImageOperation tonemapper("tonemapper");
-                tonemapper.setParam("exposure", _options.toneMapperExposure);
-                tonemapper.commit();
-                imageOps.emplace_back(tonemapper);
+                const int inY = std::min(y / scale, inSize.y - 1);
+                const float* p = in + (flipY ? inSize.y - 1 - inY : inY) * inSize.x * 4;
+                if (scale > 1)
+                {
+                    scaleRow.resize(size.x * 4);
+                    for (int x = 0; x < size.x; ++x)
+                    {
+                        memcpy(scaleRow.data() + x * 4, p + std::min(x / scale, inSize.x - 1) * 4, 4 * sizeof(float));
+                    }
+                    p = scaleRow.data();
+                }
+                if (toneMap)
+                {
+                    toneMapRow.resize(size.x * 4);
+                    toneMap->apply(p, toneMapRow.data(), size.x);
+                    p = toneMapRow.data();
+                }
+                _convert8(p, bits + (size.y - 1 - y) * scanSize, size.x, table);
             }
-            if (_options.denoiserFound && _options.denoiserEnabled && i == totalPasses - 1)
+        });
+        _frameBuffers[index].unmap(fb);
+    }
+
+    void Render::copyToDib(
+        const ospcommon::math::box2i& rect,
+        const float* color,
+        bool flipY,
+        float gamma,
+        CRhinoDib& dib)
+    {
+        const ospcommon::math::vec2i size = rect.size();
+        const int height = dib.Height();
+        if (rect.lower.x < 0 || rect.lower.y < 0 || rect.upper.x > dib.Width() || rect.upper.y > height ||
+            dib.BitsPerPixel() != 32)
+            return;
+
+        // The DIB rows are ordered from bottom to top.
+        const std::vector<uint8_t> table = getGammaTable(gamma);
+        uint8_t* bits = reinterpret_cast<uint8_t*>(dib.FindDIBBits());
+        const size_t scanSize = dib.SizeofScan();
+        tbb::parallel_for(tbb::blocked_range<int>(0, size.y), [&](const tbb::blocked_range<int>& r)
+        {
+            for (int y = r.begin(); y != r.end(); ++y)
             {
-                // Add the denoiser operation.
-                ospray::cpp::ImageOperation denoiser("denoiser");
-                denoiser.commit();
-                imageOps.emplace_back(denoiser);
+                const int windowY = flipY ? rect.upper.y - 1 - y : rect.lower.y + y;
+                _convert8(
+                    color + y * size.x * 4,
+                    bits + (height - 1 - windowY) * scanSize + rect.lower.x * 4,
+                    size.x,
+                    table.data());
             }
-            if (imageOps.size())
+        });
+    }
+
+    void Render::_copyDepth(IRhRdkRenderWindow& rdkRenderWindow, ospray::cpp::FrameBuffer& frameBuffer)
+    {
+        IRhRdkRenderWindow::IChannel* pChanDepth = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanDistanceFromCamera);
+        if (pChanDepth)
+        {
+            const ospcommon::math::vec2i size = _scene->renderRect.size();
+            _aovTemp.resize(size.x * size.y);
+            void* fb = frameBuffer.map(OSP_FB_DEPTH);
+            const float* fbP = reinterpret_cast<const float*>(fb);
+            if (_options.flipY)
             {
-                _frameBuffers[i].setParam("imageOperation", ospray::cpp::Data(imageOps));
+                _flipImage(fbP, _aovTemp.data(), size, 1);
             }
-
-            _frameBuffers[i].commit();
+            else
+            {
+                memcpy(_aovTemp.data(), fbP, size.x * size.y * sizeof(float));
+            }
+            frameBuffer.unmap(fb);
+            pChanDepth->SetValueRect(
+                _scene->windowOffset.x,
+                _scene->windowOffset.y,
+                size.x,
+                size.y,
+                size.x * sizeof(float),
+                ComponentOrder::Irrelevant,
+                _aovTemp.data());
+            pChanDepth->Close();
         }
+    }
+
+    void Render::_copyNormals(IRhRdkRenderWindow& rdkRenderWindow, ospray::cpp::FrameBuffer& frameBuffer)
+    {
+        IRhRdkRenderWindow::IChannel* pChanNormalX = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanNormalX);
+        IRhRdkRenderWindow::IChannel* pChanNormalY = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanNormalY);
+        IRhRdkRenderWindow::IChannel* pChanNormalZ = rdkRenderWindow.OpenChannel(IRhRdkRenderWindow::chanNormalZ);
+        if (pChanNormalX && pChanNormalY && pChanNormalZ)
+        {
+            // De-interleave the normals into one plane per channel.
+            const ospcommon::math::vec2i size = _scene->renderRect.size();
+            const size_t planeSize = size.x * size.y;
+            _aovTemp.resize(planeSize * 3);
+            void* fb = frameBuffer.map(OSP_FB_NORMAL);
+            _deinterleave(
+                reinterpret_cast<const float*>(fb),
+                _aovTemp.data(),
+                _aovTemp.data() + planeSize,
+                _aovTemp.data() + planeSize * 2,
+                size,
+                _options.flipY);
+            frameBuffer.unmap(fb);
 
-        if (_options.previewPasses > 0 || _options.flipY)
+            IRhRdkRenderWindow::IChannel* channels[] = { pChanNormalX, pChanNormalY, pChanNormalZ };
+            for (size_t i = 0; i < 3; ++i)
+            {
+                channels[i]->SetValueRect(
+                    _scene->windowOffset.x,
+                    _scene->windowOffset.y,
+                    size.x,
+                    size.y,
+                    size.x * sizeof(float),
+                    ComponentOrder::Irrelevant,
+                    _aovTemp.data() + planeSize * i);
+            }
+        }
+        if (pChanNormalX)
         {
-            _frameBufferTemp.resize(_frameBufferSize.x * _frameBufferSize.y * 4);
+            pChanNormalX->Close();
         }
-        else
+        if (pChanNormalY)
+        {
+            pChanNormalY->Close();
+        }
+        if (pChanNormalZ)
         {
-            _frameBufferTemp.clear();
+            pChanNormalZ->Close();
         }
     }
 
+    void Render::_callImageCallback(ospray::cpp::FrameBuffer& frameBuffer)
+    {
+        const ospcommon::math::vec2i size = _scene->renderRect.size();
+        void* color = frameBuffer.map(OSP_FB_COLOR);
+        void* depth = frameBuffer.map(OSP_FB_DEPTH);
+        void* normals = frameBuffer.map(OSP_FB_NORMAL);
+        const float* colorP = reinterpret_cast<const float*>(color);
+        if (_options.toneMapperEnabled)
+        {
+            _toneMapTemp.resize(size.x * size.y * 4);
+            _toneMap(colorP, _toneMapTemp.data(), size.x * size.y, _options.toneMapperExposure);
+            colorP = _toneMapTemp.data();
+        }
+        _imageCallback(
+            ospcommon::math::box2i(_scene->windowOffset, _scene->windowOffset + size),
+            colorP,
+            reinterpret_cast<const float*>(depth),
+            reinterpret_cast<const float*>(normals),
+            _options.flipY);
+        frameBuffer.unmap(normals);
+        frameBuffer.unmap(depth);
+        frameBuffer.unmap(color);
+    }
+
     void Render::_scale(
         const float* in,
         const ospcommon::math::vec2i& inSize,
@@ -246,17 +675,104 @@ namespace Osprey
         }
     }
 
-    void Render::_flipImage(
+    void Render::_toneMap(
         const float* in,
         float* out,
-        const ospcommon::math::vec2i& size)
+        size_t pixels,
+        float exposure)
+    {
+        const ToneMapCurve curve(exposure);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, pixels), [=, &curve](const tbb::blocked_range<size_t>& r)
+        {
+            curve.apply(in + r.begin() * 4, out + r.begin() * 4, r.size());
+        });
+    }
+
+    void Render::_convert8(
+        const float* in,
+        uint8_t* out,
+        size_t pixels,
+        const uint8_t* table)
     {
-        for (int y = 0; y < size.y; ++y)
+        // The table indices for one pixel are computed at a time.
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.F);
+        const __m128 scale = _mm_set1_ps(static_cast<float>(gammaTableSize - 1));
+        alignas(16) int32_t i[4];
+        for (size_t p = 0; p < pixels; ++p, in += 4, out += 4)
         {
-            const float* inP = in + y * size.x * 4;
-            float* outP = out + (size.y - 1 - y) * size.x * 4;
-            memcpy(outP, inP, size.x * 4 * sizeof(float));
+            const __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in), zero), one);
+            _mm_store_si128(reinterpret_cast<__m128i*>(i), _mm_cvtps_epi32(_mm_mul_ps(v, scale)));
+            out[0] = table[i[2]];
+            out[1] = table[i[1]];
+            out[2] = table[i[0]];
+            out[3] = 255;
         }
     }
 
+    void Render::_flipImage(
+        const float* in,
+        float* out,
+        const ospcommon::math::vec2i& size,
+        size_t channels)
+    {
+        const size_t rowSize = size.x * channels;
+        tbb::parallel_for(tbb::blocked_range<int>(0, size.y), [in, out, &size, rowSize](const tbb::blocked_range<int>& r)
+        {
+            for (int y = r.begin(); y != r.end(); ++y)
+            {
+                const float* inP = in + y * rowSize;
+                float* outP = out + (size.y - 1 - y) * rowSize;
+                memcpy(outP, inP, rowSize * sizeof(float));
+            }
+        });
+    }
+
+    void Render::_deinterleave(
+        const float* in,
+        float* outX,
+        float* outY,
+        float* outZ,
+        const ospcommon::math::vec2i& size,
+        bool flipY)
+    {
+        tbb::parallel_for(tbb::blocked_range<int>(0, size.y), [=](const tbb::blocked_range<int>& r)
+        {
+            for (int y = r.begin(); y != r.end(); ++y)
+            {
+                const float* inP = in + y * size.x * 3;
+                const size_t row = (flipY ? size.y - 1 - y : y) * size.x;
+                float* x = outX + row;
+                float* yy = outY + row;
+                float* z = outZ + row;
+
+                // Four pixels are de-interleaved at a time from three vectors:
+                // (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3)
+                int i = 0;
+                for (; i + 4 <= size.x; i += 4, inP += 12)
+                {
+                    const __m128 a = _mm_loadu_ps(inP);
+                    const __m128 b = _mm_loadu_ps(inP + 4);
+                    const __m128 c = _mm_loadu_ps(inP + 8);
+                    const __m128 t = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));
+                    _mm_storeu_ps(x + i, _mm_shuffle_ps(a, t, _MM_SHUFFLE(3, 0, 3, 0)));
+                    _mm_storeu_ps(yy + i, _mm_shuffle_ps(
+                        _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                        _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                        _MM_SHUFFLE(2, 0, 2, 0)));
+                    _mm_storeu_ps(z + i, _mm_shuffle_ps(
+                        _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                        _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                        _MM_SHUFFLE(2, 0, 2, 0)));
+                }
+                for (; i < size.x; ++i, inP += 3)
+                {
+                    x[i] = inP[0];
+                    yy[i] = inP[1];
+                    z[i] = inP[2];
+                }
+            }
+        });
+    }
+
 } // namespace Osprey
@@ -23,12 +23,90 @@ namespace Osprey
         //! \param Rectangle within the window to render.
         void init(const Options&, const std::shared_ptr<Scene>&);
 
-        //! Render a pass.
-		void render(size_t pass, IRhRdkRenderWindow&);
+        //! Render a pass. The optional callback is called periodically with
+        //! the progress of the pass, and the pass is cancelled if it returns
+        //! false. Returns false if the pass was cancelled.
+		bool render(
+            size_t pass,
+            IRhRdkRenderWindow&,
+            const std::function<bool(float)>& progress = nullptr);
+
+        //! Get whether the options only differ in the post-processing (tone
+        //! mapping and denoising), which is applied without restarting the
+        //! accumulation.
+        static bool isPostProcessChange(const Options&, const Options&);
+
+        //! Set the post-processing options without clearing the frame
+        //! buffers. Returns true if the denoiser was enabled or disabled, in
+        //! which case another pass is needed to apply it.
+        bool setPostProcess(const Options&);
+
+        //! Copy the last rendered image to Rhino again with the current tone
+        //! mapping.
+        void updateImage(IRhRdkRenderWindow&);
+
+        //! This callback receives the final image of each render rectangle
+        //! while the frame buffer is mapped, so that it can be written without
+        //! copying. The rectangle is in window coordinates, and the color
+        //! (RGBA), depth and normal (XYZ) rows are ordered from bottom to top
+        //! if the flipY argument is true.
+        typedef std::function<void(
+            const ospcommon::math::box2i&,
+            const float* color,
+            const float* depth,
+            const float* normals,
+            bool flipY)> ImageCallback;
+
+        //! Set the callback for the final image.
+        void setImageCallback(const ImageCallback&);
+
+        //! Set the image for the interactive viewport. When this is set the
+        //! color is converted to 8-bit with the scene gamma and written to the
+        //! image instead of the render window, and the depth and normals are
+        //! not copied.
+        void setViewportImage(const std::shared_ptr<ViewportImage>&);
+
+        //! Convert a rectangle of RGBA pixels to 8-bit with the given gamma and
+        //! copy them to a 32-bit DIB. The rectangle is in window coordinates,
+        //! and the rows of the pixels are ordered from bottom to top if flipY
+        //! is true.
+        static void copyToDib(
+            const ospcommon::math::box2i&,
+            const float* color,
+            bool flipY,
+            float gamma,
+            CRhinoDib&);
+
+        //! Get the variance of the last full resolution pass.
+        float getVariance() const;
+
+        //! Split a rectangle into buckets. A bucket size of zero returns the
+        //! whole rectangle.
+        static std::vector<ospcommon::math::box2i> getBuckets(const ospcommon::math::box2i&, size_t bucketSize);
+
+        //! Get a bucket size that keeps the frame buffers for the given image
+        //! size within the available memory. Returns zero if buckets are not
+        //! needed.
+        static size_t getAutoBucketSize(const ospcommon::math::vec2i&);
 
 	private:
         void _initFrameBuffers(const ospcommon::math::vec2i&);
 
+        //! Get whether the denoiser is applied to the given pass.
+        bool _isDenoisePass(size_t pass) const;
+        void _setDenoiser(size_t index, bool);
+
+        void _copyColor(IRhRdkRenderWindow&);
+        void _copyViewport(size_t index);
+
+        //! Apply the tone mapping to RGBA pixels. This matches the OSPRay
+        //! tone mapper operation with the default parameters.
+        static void _toneMap(
+            const float* in,
+            float* out,
+            size_t pixels,
+            float exposure);
+
         static void _scale(
             const float* in,
             const ospcommon::math::vec2i& inSize,
@@ -37,10 +115,31 @@ namespace Osprey
             int scale,
             bool flipY);
 
+        void _copyDepth(IRhRdkRenderWindow&, ospray::cpp::FrameBuffer&);
+        void _copyNormals(IRhRdkRenderWindow&, ospray::cpp::FrameBuffer&);
+        void _callImageCallback(ospray::cpp::FrameBuffer&);
+
+        //! Convert RGBA pixels to 8-bit BGRA pixels with a gamma table.
+        static void _convert8(
+            const float* in,
+            uint8_t* out,
+            size_t pixels,
+            const uint8_t* table);
+
         static void _flipImage(
             const float* in,
             float* out,
-            const ospcommon::math::vec2i& size);
+            const ospcommon::math::vec2i& size,
+            size_t channels);
+
+        //! De-interleave three channel pixels into planes.
+        static void _deinterleave(
+            const float* in,
+            float* outX,
+            float* outY,
+            float* outZ,
+            const ospcommon::math::vec2i& size,
+            bool flipY);
 
         Options _options;
         std::shared_ptr<Scene> _scene;
@@ -48,7 +147,20 @@ namespace Osprey
         ospcommon::math::vec2i _frameBufferSize;
         std::vector<ospray::cpp::FrameBuffer> _frameBuffers;
         std::vector<ospcommon::math::vec2i> _frameBuffersSizes;
+        std::vector<bool> _frameBuffersDenoiser;
+        std::chrono::steady_clock::time_point _denoiseTime;
+        //! The linear color of the last rendered pass, before tone mapping.
+        //! This is not used for the viewport image, which is converted from
+        //! the frame buffer.
         std::vector<float> _frameBufferTemp;
+        size_t _imageIndex = 0;
+        bool _imageValid = false;
+        std::vector<float> _toneMapTemp;
+        std::vector<float> _aovTemp;
+        ImageCallback _imageCallback;
+        std::shared_ptr<ViewportImage> _viewportImage;
+        float _gammaTableValue = 0.F;
+        std::vector<uint8_t> _gammaTable;
 	};
 
 } // namespace Osprey
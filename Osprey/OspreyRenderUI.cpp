@@ -79,6 +79,84 @@ namespace Osprey
         {
             _toneMapperExposureComboBox.SetCurSel(static_cast<int>(value));
         });
+        _flattenMeshesObserver = ValueObserver<bool>::create(
+            settings->observeFlattenMeshes(),
+            [this](bool value)
+        {
+            _flattenMeshesCheckBox.SetCheck(value ? BST_CHECKED : BST_UNCHECKED);
+        });
+        _bvhPolicyObserver = ValueObserver<BVHPolicy>::create(
+            settings->observeBVHPolicy(),
+            [this](BVHPolicy value)
+        {
+            _bvhPolicyComboBox.SetCurSel(static_cast<int>(value));
+        });
+        _bucketSizeObserver = ValueObserver<BucketSize>::create(
+            settings->observeBucketSize(),
+            [this](BucketSize value)
+        {
+            _bucketSizeComboBox.SetCurSel(static_cast<int>(value));
+        });
+        _checkpointsObserver = ValueObserver<bool>::create(
+            settings->observeCheckpoints(),
+            [this](bool value)
+        {
+            _checkpointsCheckBox.SetCheck(value ? BST_CHECKED : BST_UNCHECKED);
+        });
+        _deviceObserver = ValueObserver<Device>::create(
+            settings->observeDevice(),
+            [this](Device value)
+        {
+            _deviceComboBox.SetCurSel(static_cast<int>(value));
+        });
+        _threadCountObserver = ValueObserver<ThreadCount>::create(
+            settings->observeThreadCount(),
+            [this](ThreadCount value)
+        {
+            _threadCountComboBox.SetCurSel(static_cast<int>(value));
+        });
+        _reservedCoresObserver = ValueObserver<ReservedCores>::create(
+            settings->observeReservedCores(),
+            [this](ReservedCores value)
+        {
+            _reservedCoresComboBox.SetCurSel(static_cast<int>(value));
+        });
+        _threadAffinityObserver = ValueObserver<bool>::create(
+            settings->observeThreadAffinity(),
+            [this](bool value)
+        {
+            _threadAffinityCheckBox.SetCheck(value ? BST_CHECKED : BST_UNCHECKED);
+        });
+        _logLevelObserver = ValueObserver<LogLevel>::create(
+            settings->observeLogLevel(),
+            [this](LogLevel value)
+        {
+            _logLevelComboBox.SetCurSel(static_cast<int>(value));
+        });
+        _logFileObserver = ValueObserver<bool>::create(
+            settings->observeLogFile(),
+            [this](bool value)
+        {
+            _logFileCheckBox.SetCheck(value ? BST_CHECKED : BST_UNCHECKED);
+        });
+        _denoiserIntervalObserver = ValueObserver<DenoiserInterval>::create(
+            settings->observeDenoiserInterval(),
+            [this](DenoiserInterval value)
+        {
+            _denoiserIntervalComboBox.SetCurSel(static_cast<int>(value));
+        });
+        _denoisePreviewsObserver = ValueObserver<bool>::create(
+            settings->observeDenoisePreviews(),
+            [this](bool value)
+        {
+            _denoisePreviewsCheckBox.SetCheck(value ? BST_CHECKED : BST_UNCHECKED);
+        });
+        _pointBudgetObserver = ValueObserver<PointBudget>::create(
+            settings->observePointBudget(),
+            [this](PointBudget value)
+        {
+            _pointBudgetComboBox.SetCurSel(static_cast<int>(value));
+        });
     }
 
     RenderUI::~RenderUI()
@@ -158,6 +236,72 @@ namespace Osprey
             _toneMapperExposureComboBox.AddString(getExposureLabel(i).c_str());
         }
         _toneMapperExposureComboBox.SetCurSel(static_cast<int>(_settings->observeToneMapperExposure()->get()));
+
+        _flattenMeshesCheckBox.SetCheck(_settings->observeFlattenMeshes()->get() ? BST_CHECKED : BST_UNCHECKED);
+
+        _bvhPolicyComboBox.ResetContent();
+        for (const auto& i : getBVHPolicyEnums())
+        {
+            _bvhPolicyComboBox.AddString(getBVHPolicyLabel(i).c_str());
+        }
+        _bvhPolicyComboBox.SetCurSel(static_cast<int>(_settings->observeBVHPolicy()->get()));
+
+        _bucketSizeComboBox.ResetContent();
+        for (const auto& i : getBucketSizeEnums())
+        {
+            _bucketSizeComboBox.AddString(getBucketSizeLabel(i).c_str());
+        }
+        _bucketSizeComboBox.SetCurSel(static_cast<int>(_settings->observeBucketSize()->get()));
+
+        _checkpointsCheckBox.SetCheck(_settings->observeCheckpoints()->get() ? BST_CHECKED : BST_UNCHECKED);
+
+        _deviceComboBox.ResetContent();
+        for (const auto& i : getDeviceEnums())
+        {
+            _deviceComboBox.AddString(getDeviceLabel(i).c_str());
+        }
+        _deviceComboBox.SetCurSel(static_cast<int>(_settings->observeDevice()->get()));
+
+        _threadCountComboBox.ResetContent();
+        for (const auto& i : getThreadCountEnums())
+        {
+            _threadCountComboBox.AddString(getThreadCountLabel(i).c_str());
+        }
+        _threadCountComboBox.SetCurSel(static_cast<int>(_settings->observeThreadCount()->get()));
+
+        _reservedCoresComboBox.ResetContent();
+        for (const auto& i : getReservedCoresEnums())
+        {
+            _reservedCoresComboBox.AddString(getReservedCoresLabel(i).c_str());
+        }
+        _reservedCoresComboBox.SetCurSel(static_cast<int>(_settings->observeReservedCores()->get()));
+
+        _threadAffinityCheckBox.SetCheck(_settings->observeThreadAffinity()->get() ? BST_CHECKED : BST_UNCHECKED);
+
+        _logLevelComboBox.ResetContent();
+        for (const auto& i : getLogLevelEnums())
+        {
+            _logLevelComboBox.AddString(getLogLevelLabel(i).c_str());
+        }
+        _logLevelComboBox.SetCurSel(static_cast<int>(_settings->observeLogLevel()->get()));
+
+        _logFileCheckBox.SetCheck(_settings->observeLogFile()->get() ? BST_CHECKED : BST_UNCHECKED);
+
+        _denoiserIntervalComboBox.ResetContent();
+        for (const auto& i : getDenoiserIntervalEnums())
+        {
+            _denoiserIntervalComboBox.AddString(getDenoiserIntervalLabel(i).c_str());
+        }
+        _denoiserIntervalComboBox.SetCurSel(static_cast<int>(_settings->observeDenoiserInterval()->get()));
+
+        _denoisePreviewsCheckBox.SetCheck(_settings->observeDenoisePreviews()->get() ? BST_CHECKED : BST_UNCHECKED);
+
+        _pointBudgetComboBox.ResetContent();
+        for (const auto& i : getPointBudgetEnums())
+        {
+            _pointBudgetComboBox.AddString(getPointBudgetLabel(i).c_str());
+        }
+        _pointBudgetComboBox.SetCurSel(static_cast<int>(_settings->observePointBudget()->get()));
     }
 
     BEGIN_MESSAGE_MAP(RenderUI, CRhRdkRenderSettingsSection_MFC)
@@ -169,6 +313,19 @@ namespace Osprey
         ON_BN_CLICKED(IDD_OPTIONS_DENOISER_CHECKBOX, OnDenoiserCheckBox)
         ON_BN_CLICKED(IDD_OPTIONS_TONE_MAPPER_CHECKBOX, OnToneMapperCheckBox)
         ON_CBN_SELCHANGE(IDD_OPTIONS_TONE_MAPPER_EXPOSURE_COMBOBOX, OnToneMapperExposureComboBox)
+        ON_BN_CLICKED(IDD_OPTIONS_FLATTEN_MESHES_CHECKBOX, OnFlattenMeshesCheckBox)
+        ON_CBN_SELCHANGE(IDD_OPTIONS_BVH_POLICY_COMBOBOX, OnBVHPolicyComboBox)
+        ON_CBN_SELCHANGE(IDD_OPTIONS_BUCKET_SIZE_COMBOBOX, OnBucketSizeComboBox)
+        ON_BN_CLICKED(IDD_OPTIONS_CHECKPOINTS_CHECKBOX, OnCheckpointsCheckBox)
+        ON_CBN_SELCHANGE(IDD_OPTIONS_DEVICE_COMBOBOX, OnDeviceComboBox)
+        ON_CBN_SELCHANGE(IDD_OPTIONS_THREAD_COUNT_COMBOBOX, OnThreadCountComboBox)
+        ON_CBN_SELCHANGE(IDD_OPTIONS_RESERVED_CORES_COMBOBOX, OnReservedCoresComboBox)
+        ON_BN_CLICKED(IDD_OPTIONS_THREAD_AFFINITY_CHECKBOX, OnThreadAffinityCheckBox)
+        ON_CBN_SELCHANGE(IDD_OPTIONS_LOG_LEVEL_COMBOBOX, OnLogLevelComboBox)
+        ON_BN_CLICKED(IDD_OPTIONS_LOG_FILE_CHECKBOX, OnLogFileCheckBox)
+        ON_CBN_SELCHANGE(IDD_OPTIONS_DENOISER_INTERVAL_COMBOBOX, OnDenoiserIntervalComboBox)
+        ON_BN_CLICKED(IDD_OPTIONS_DENOISE_PREVIEWS_CHECKBOX, OnDenoisePreviewsCheckBox)
+        ON_CBN_SELCHANGE(IDD_OPTIONS_POINT_BUDGET_COMBOBOX, OnPointBudgetComboBox)
     END_MESSAGE_MAP()
 
     void RenderUI::DoDataExchange(CDataExchange* pDX)
@@ -181,6 +338,19 @@ namespace Osprey
         DDX_Control(pDX, IDD_OPTIONS_DENOISER_CHECKBOX, _denoiserCheckBox);
         DDX_Control(pDX, IDD_OPTIONS_TONE_MAPPER_CHECKBOX, _toneMapperCheckBox);
         DDX_Control(pDX, IDD_OPTIONS_TONE_MAPPER_EXPOSURE_COMBOBOX, _toneMapperExposureComboBox);
+        DDX_Control(pDX, IDD_OPTIONS_FLATTEN_MESHES_CHECKBOX, _flattenMeshesCheckBox);
+        DDX_Control(pDX, IDD_OPTIONS_BVH_POLICY_COMBOBOX, _bvhPolicyComboBox);
+        DDX_Control(pDX, IDD_OPTIONS_BUCKET_SIZE_COMBOBOX, _bucketSizeComboBox);
+        DDX_Control(pDX, IDD_OPTIONS_CHECKPOINTS_CHECKBOX, _checkpointsCheckBox);
+        DDX_Control(pDX, IDD_OPTIONS_DEVICE_COMBOBOX, _deviceComboBox);
+        DDX_Control(pDX, IDD_OPTIONS_THREAD_COUNT_COMBOBOX, _threadCountComboBox);
+        DDX_Control(pDX, IDD_OPTIONS_RESERVED_CORES_COMBOBOX, _reservedCoresComboBox);
+        DDX_Control(pDX, IDD_OPTIONS_THREAD_AFFINITY_CHECKBOX, _threadAffinityCheckBox);
+        DDX_Control(pDX, IDD_OPTIONS_LOG_LEVEL_COMBOBOX, _logLevelComboBox);
+        DDX_Control(pDX, IDD_OPTIONS_LOG_FILE_CHECKBOX, _logFileCheckBox);
+        DDX_Control(pDX, IDD_OPTIONS_DENOISER_INTERVAL_COMBOBOX, _denoiserIntervalComboBox);
+        DDX_Control(pDX, IDD_OPTIONS_DENOISE_PREVIEWS_CHECKBOX, _denoisePreviewsCheckBox);
+        DDX_Control(pDX, IDD_OPTIONS_POINT_BUDGET_COMBOBOX, _pointBudgetComboBox);
         __super::DoDataExchange(pDX);
     }
 
@@ -250,4 +420,74 @@ namespace Osprey
         _settings->setToneMapperExposure(static_cast<Exposure>(_toneMapperExposureComboBox.GetCurSel()));
     }
 
+    void RenderUI::OnFlattenMeshesCheckBox()
+    {
+        const bool value = !(_flattenMeshesCheckBox.GetCheck() == BST_CHECKED);
+        _settings->setFlattenMeshes(value);
+    }
+
+    void RenderUI::OnBVHPolicyComboBox()
+    {
+        _settings->setBVHPolicy(static_cast<BVHPolicy>(_bvhPolicyComboBox.GetCurSel()));
+    }
+
+    void RenderUI::OnBucketSizeComboBox()
+    {
+        _settings->setBucketSize(static_cast<BucketSize>(_bucketSizeComboBox.GetCurSel()));
+    }
+
+    void RenderUI::OnCheckpointsCheckBox()
+    {
+        const bool value = !(_checkpointsCheckBox.GetCheck() == BST_CHECKED);
+        _settings->setCheckpoints(value);
+    }
+
+    void RenderUI::OnDeviceComboBox()
+    {
+        _settings->setDevice(static_cast<Device>(_deviceComboBox.GetCurSel()));
+    }
+
+    void RenderUI::OnThreadCountComboBox()
+    {
+        _settings->setThreadCount(static_cast<ThreadCount>(_threadCountComboBox.GetCurSel()));
+    }
+
+    void RenderUI::OnReservedCoresComboBox()
+    {
+        _settings->setReservedCores(static_cast<ReservedCores>(_reservedCoresComboBox.GetCurSel()));
+    }
+
+    void RenderUI::OnThreadAffinityCheckBox()
+    {
+        const bool value = !(_threadAffinityCheckBox.GetCheck() == BST_CHECKED);
+        _settings->setThreadAffinity(value);
+    }
+
+    void RenderUI::OnLogLevelComboBox()
+    {
+        _settings->setLogLevel(static_cast<LogLevel>(_logLevelComboBox.GetCurSel()));
+    }
+
+    void RenderUI::OnLogFileCheckBox()
+    {
+        const bool value = !(_logFileCheckBox.GetCheck() == BST_CHECKED);
+        _settings->setLogFile(value);
+    }
+
+    void RenderUI::OnDenoiserIntervalComboBox()
+    {
+        _settings->setDenoiserInterval(static_cast<DenoiserInterval>(_denoiserIntervalComboBox.GetCurSel()));
+    }
+
+    void RenderUI::OnDenoisePreviewsCheckBox()
+    {
+        const bool value = !(_denoisePreviewsCheckBox.GetCheck() == BST_CHECKED);
+        _settings->setDenoisePreviews(value);
+    }
+
+    void RenderUI::OnPointBudgetComboBox()
+    {
+        _settings->setPointBudget(static_cast<PointBudget>(_pointBudgetComboBox.GetCurSel()));
+    }
+
 } // namespace Osprey
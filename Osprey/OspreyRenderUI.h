@@ -38,6 +38,19 @@ namespace Osprey
         afx_msg void OnDenoiserCheckBox();
         afx_msg void OnToneMapperCheckBox();
         afx_msg void OnToneMapperExposureComboBox();
+        afx_msg void OnFlattenMeshesCheckBox();
+        afx_msg void OnBVHPolicyComboBox();
+        afx_msg void OnBucketSizeComboBox();
+        afx_msg void OnCheckpointsCheckBox();
+        afx_msg void OnDeviceComboBox();
+        afx_msg void OnThreadCountComboBox();
+        afx_msg void OnReservedCoresComboBox();
+        afx_msg void OnThreadAffinityCheckBox();
+        afx_msg void OnLogLevelComboBox();
+        afx_msg void OnLogFileCheckBox();
+        afx_msg void OnDenoiserIntervalComboBox();
+        afx_msg void OnDenoisePreviewsCheckBox();
+        afx_msg void OnPointBudgetComboBox();
         DECLARE_MESSAGE_MAP()
 
 	private:
@@ -51,6 +64,19 @@ namespace Osprey
         CButton _denoiserCheckBox;
         CButton _toneMapperCheckBox;
         CComboBox _toneMapperExposureComboBox;
+        CButton _flattenMeshesCheckBox;
+        CComboBox _bvhPolicyComboBox;
+        CComboBox _bucketSizeComboBox;
+        CButton _checkpointsCheckBox;
+        CComboBox _deviceComboBox;
+        CComboBox _threadCountComboBox;
+        CComboBox _reservedCoresComboBox;
+        CButton _threadAffinityCheckBox;
+        CComboBox _logLevelComboBox;
+        CButton _logFileCheckBox;
+        CComboBox _denoiserIntervalComboBox;
+        CButton _denoisePreviewsCheckBox;
+        CComboBox _pointBudgetComboBox;
 
 		std::shared_ptr<ValueObserver<Renderer> > _rendererObserver;
         std::shared_ptr<ValueObserver<Passes> > _passesObserver;
@@ -61,6 +87,19 @@ namespace Osprey
 		std::shared_ptr<ValueObserver<bool> > _denoiserEnabledObserver;
         std::shared_ptr<ValueObserver<bool> > _toneMapperEnabledObserver;
         std::shared_ptr<ValueObserver<Exposure> > _toneMapperExposureObserver;
+        std::shared_ptr<ValueObserver<bool> > _flattenMeshesObserver;
+        std::shared_ptr<ValueObserver<BVHPolicy> > _bvhPolicyObserver;
+        std::shared_ptr<ValueObserver<BucketSize> > _bucketSizeObserver;
+        std::shared_ptr<ValueObserver<bool> > _checkpointsObserver;
+        std::shared_ptr<ValueObserver<Device> > _deviceObserver;
+        std::shared_ptr<ValueObserver<ThreadCount> > _threadCountObserver;
+        std::shared_ptr<ValueObserver<ReservedCores> > _reservedCoresObserver;
+        std::shared_ptr<ValueObserver<bool> > _threadAffinityObserver;
+        std::shared_ptr<ValueObserver<LogLevel> > _logLevelObserver;
+        std::shared_ptr<ValueObserver<bool> > _logFileObserver;
+        std::shared_ptr<ValueObserver<DenoiserInterval> > _denoiserIntervalObserver;
+        std::shared_ptr<ValueObserver<bool> > _denoisePreviewsObserver;
+        std::shared_ptr<ValueObserver<PointBudget> > _pointBudgetObserver;
     };
 
 } // namespace Osprey
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#include "stdafx.h"
+#include "OspreyChangeQueue.h"
+#include "OspreyResidentScene.h"
+#include "OspreyUtil.h"
+
+namespace Osprey
+{
+    ResidentScene::ResidentScene()
+    {}
+
+    ResidentScene::~ResidentScene()
+    {}
+
+    std::shared_ptr<ResidentScene> ResidentScene::create(const CRhinoDoc& rhinoDoc, const ON_3dmView& view)
+    {
+        auto out = std::shared_ptr<ResidentScene>(new ResidentScene);
+        out->_docSerialNumber = rhinoDoc.RuntimeSerialNumber();
+
+        out->_update = std::make_shared<Update>();
+
+        out->_scene = std::make_shared<Scene>();
+        out->_scene->world = ospray::cpp::World();
+
+        out->_changeQueue = std::shared_ptr<ChangeQueue>(new ChangeQueue(rhinoDoc, view, out->_update, out->_scene));
+
+        return out;
+    }
+
+    unsigned int ResidentScene::getDocSerialNumber() const
+    {
+        return _docSerialNumber;
+    }
+
+    void ResidentScene::update(const Options& options, const ON_3dmView& view)
+    {
+        const auto updateStart = std::chrono::steady_clock::now();
+
+        // The world is only created from scratch the first time, or when the
+        // flattening changes.
+        _changeQueue->setRendererName(options.rendererName, options.supportsMaterials);
+        _changeQueue->setBVHPolicy(options.bvhPolicy);
+        const bool createWorld = _changeQueue->setFlattenMeshes(options.flattenMeshes) || !_worldInit;
+        if (createWorld)
+        {
+            _worldInit = true;
+            _changeQueue->CreateWorld();
+        }
+        else
+        {
+            _changeQueue->Flush();
+        }
+        _changeQueue->ApplyViewChange(view);
+
+        std::stringstream ss;
+        ss << "Scene " << (createWorld ? "create" : "update") << ": " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - updateStart).count() << " ms";
+        printDebug(ss.str());
+    }
+
+    const std::shared_ptr<Scene>& ResidentScene::getScene() const
+    {
+        return _scene;
+    }
+
+    uint32_t ResidentScene::getContentHash() const
+    {
+        return _changeQueue->getContentHash();
+    }
+
+} // namespace Osprey
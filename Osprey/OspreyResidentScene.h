@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#pragma once
+
+#include "OspreyData.h"
+
+namespace Osprey
+{
+    class ChangeQueue;
+
+    //! This class keeps the OSPRay world of a document resident between
+    //! renders. The world is created for the first render, and after that
+    //! only the document changes since the last render are applied.
+    class ResidentScene
+    {
+        ResidentScene();
+        ResidentScene(const ResidentScene&) = delete;
+        ResidentScene& operator = (const ResidentScene&) = delete;
+
+    public:
+        ~ResidentScene();
+
+        // Create a new instance.
+        static std::shared_ptr<ResidentScene> create(const CRhinoDoc&, const ON_3dmView&);
+
+        //! Get the runtime serial number of the document.
+        unsigned int getDocSerialNumber() const;
+
+        //! Apply the options and the document changes since the last update,
+        //! and set the camera from the view.
+        void update(const Options&, const ON_3dmView&);
+
+        //! Get the scene.
+        const std::shared_ptr<Scene>& getScene() const;
+
+        //! Get a hash of the render content (materials, environment, and
+        //! lighting) applied by the last update.
+        uint32_t getContentHash() const;
+
+    private:
+        unsigned int _docSerialNumber = 0;
+        std::shared_ptr<Update> _update;
+        std::shared_ptr<Scene> _scene;
+        std::shared_ptr<ChangeQueue> _changeQueue;
+        bool _worldInit = false;
+    };
+
+} // namespace Osprey
@@ -2,13 +2,22 @@
 // Copyright (c) 2020 Darby Johnston, All rights reserved
 
 #include "stdafx.h"
-#include "OspreyChangeQueue.h"
+#include "OspreyCheckpoint.h"
+#include "OspreyLog.h"
 #include "OspreyPlugIn.h"
 #include "OspreyRender.h"
+#include "OspreyResidentScene.h"
 #include "OspreySdkRender.h"
 #include "OspreySettings.h"
 #include "OspreyUtil.h"
 
+namespace
+{
+    // The bucket size used for checkpoints when buckets are not enabled.
+    const size_t checkpointBucketSize = 512;
+
+} // namespace
+
 OspreySdkRender::OspreySdkRender(
     const std::shared_ptr<Osprey::Settings>& settings,
 	const CRhinoCommandContext& context,
@@ -17,28 +26,16 @@ OspreySdkRender::OspreySdkRender(
 	UINT id) :
 	CRhRdkSdkRender(context, plugin, sCaption, id)
 {
-    _options.rendererName = Osprey::getRendererValue(settings->observeRenderer()->get());
-    _options.supportsMaterials = Osprey::getRendererSupportsMaterials(settings->observeRenderer()->get());
-    _options.passes = Osprey::getPassesValue(settings->observePasses()->get());
-    _options.previewPasses = Osprey::getPreviewPassesValue(settings->observePreviewPasses()->get());
-    _options.pixelSamples = Osprey::getPixelSamplesValue(settings->observePixelSamples()->get());
-    _options.aoSamples = Osprey::getAOSamplesValue(settings->observeAOSamples()->get());
-    _options.denoiserFound = settings->observeDenoiserFound()->get();
-    _options.denoiserEnabled = settings->observeDenoiserEnabled()->get();
-    _options.toneMapperEnabled = settings->observeToneMapperEnabled()->get();
-    _options.toneMapperExposure = Osprey::getExposureValue(settings->observeToneMapperExposure()->get());
+    _options = settings->getOptions();
     _options.flipY = true;
 
-    _update = std::make_shared<Osprey::Update>();
-
-    _scene = std::make_shared<Osprey::Scene>();
-    _scene->world = ospray::cpp::World();
-
+    // Use the resident scene of the document so that repeated renders only
+    // apply the document changes instead of building the whole scene.
     const auto rhinoDoc = context.Document();
     const auto& view = RhinoApp().ActiveView()->ActiveViewport().View();
-    _changeQueue = std::shared_ptr<Osprey::ChangeQueue>(new Osprey::ChangeQueue(*rhinoDoc, view, _update, _scene));
-    _changeQueue->setRendererName(_options.rendererName, _options.supportsMaterials);
-    _changeQueue->CreateWorld();
+    _residentScene = ::OspreyPlugIn().GetResidentScene(*rhinoDoc, view);
+    _residentScene->update(_options, view);
+    _scene = _residentScene->getScene();
 
     _render = Osprey::Render::create();
 
@@ -70,6 +67,7 @@ CRhinoSdkRender::RenderReturnCodes OspreySdkRender::Render(const ON_2iSize& rend
     _scene->renderRect = ospcommon::math::box2i(
         ospcommon::math::vec2i(0, 0),
         ospcommon::math::vec2i(renderSize.cx, renderSize.cy));
+    _updateSceneHash();
 
     CRhinoSdkRender::RenderReturnCodes rc = CRhRdkSdkRender::Render(renderSize);
 	return rc;
@@ -88,6 +86,7 @@ CRhinoSdkRender::RenderReturnCodes OspreySdkRender::RenderWindow(CRhinoView* rhi
     _scene->renderRect = ospcommon::math::box2i(
         ospcommon::math::vec2i(pRect->left, pRect->top),
         ospcommon::math::vec2i(pRect->right, pRect->bottom));
+    _updateSceneHash();
 
 	auto& rdkRenderWindow = GetRenderWindow();
 	rdkRenderWindow.SetSize(Osprey::toRhino(_scene->renderRect.size()));
@@ -105,6 +104,22 @@ CRhinoSdkRender::RenderReturnCodes OspreySdkRender::RenderWindow(CRhinoView* rhi
 	return rc;
 }
 
+void OspreySdkRender::_updateSceneHash()
+{
+    const CRhinoDoc* rhinoDoc = CommandContext().Document();
+    const CRhinoView* rhinoView = RhinoApp().ActiveView();
+    if (_options.checkpoints && rhinoDoc && rhinoView)
+    {
+        _sceneHash = Osprey::Checkpoint::getSceneHash(
+            *rhinoDoc,
+            rhinoView->ActiveViewport().View(),
+            _options,
+            _scene->renderSize,
+            _scene->renderRect,
+            _residentScene->getContentHash());
+    }
+}
+
 BOOL OspreySdkRender::NeedToProcessGeometryTable()
 {
 	return ::OspreyPlugIn().SceneChanged();
@@ -140,6 +155,8 @@ BOOL OspreySdkRender::RenderEnterModalLoop()
 
 BOOL OspreySdkRender::RenderContinueModal()
 {
+    // Print the messages from the render thread.
+    Osprey::drainLog();
 	return m_bContinueModal;
 }
 
@@ -182,22 +199,119 @@ void OspreySdkRender::ThreadedRender(void)
 {
 	m_bCancel = false;
 
-    _render->init(_options, _scene);
-
 	auto& rhinoRenderWindow = GetRenderWindow();
-    const size_t totalPasses = _options.passes + _options.previewPasses;
-	for (size_t pass = 0; pass < totalPasses && !m_bCancel; ++pass)
-	{
-        ON_wString s = ON_wString::FormatToString(L"Rendering pass %d...", pass + 1);
-        rhinoRenderWindow.SetProgress(s, static_cast<int>(pass / static_cast<float>(totalPasses) * 100));
+    const auto renderStart = std::chrono::steady_clock::now();
+
+    // Split the image into buckets so that the frame buffer memory depends
+    // on the bucket size instead of the image size.
+    const ospcommon::math::box2i renderRect = _scene->renderRect;
+    size_t bucketSize = Osprey::getBucketSizeValue(_options.bucketSize);
+    if (Osprey::BucketSize::Automatic == _options.bucketSize)
+    {
+        bucketSize = Osprey::Render::getAutoBucketSize(renderRect.size());
+    }
+    if (_options.checkpoints && 0 == bucketSize)
+    {
+        // Checkpoints are saved for each finished bucket.
+        bucketSize = checkpointBucketSize;
+    }
+    const auto buckets = Osprey::Render::getBuckets(renderRect, bucketSize);
+    Osprey::Options options = _options;
+    std::shared_ptr<Osprey::Scene> scene = _scene;
+    if (buckets.size() > 1)
+    {
+        // The preview passes are not used since each bucket is rendered to
+        // completion before moving to the next one.
+        options.previewPasses = 0;
+        scene = std::make_shared<Osprey::Scene>(*_scene);
+    }
+
+    const size_t bucketPasses = options.passes + options.previewPasses;
+    const size_t totalPasses = buckets.size() * bucketPasses;
 
-        _render->render(pass, rhinoRenderWindow);
+    // Resume from the buckets that were finished by an earlier render of the
+    // same scene, and save each bucket as it finishes.
+    std::shared_ptr<Osprey::Checkpoint> checkpoint;
+    if (_options.checkpoints)
+    {
+        checkpoint = Osprey::Checkpoint::create(_sceneHash, renderRect.size(), options.passes);
+    }
+    if (checkpoint)
+    {
+        checkpoint->restore(rhinoRenderWindow);
+        if (checkpoint->getFinishedCount() > 0)
+        {
+            std::stringstream ss;
+            ss << "Resuming render: " << checkpoint->getFinishedCount() << " of " << buckets.size() << " buckets finished";
+            Osprey::printMessage(ss.str());
+        }
+        _render->setImageCallback([this, checkpoint, &options](
+            const ospcommon::math::box2i& rect,
+            const float* color,
+            const float* depth,
+            const float* normals,
+            bool flipY)
+        {
+            if (!m_bCancel)
+            {
+                checkpoint->add(rect, color, depth, normals, options.passes, _render->getVariance(), flipY);
+            }
+        });
+    }
 
-        if (pass == totalPasses - 1)
+    size_t pass = 0;
+    for (size_t i = 0; i < buckets.size() && !m_bCancel; ++i)
+    {
+        scene->renderRect = buckets[i];
+        scene->windowOffset = buckets[i].lower - renderRect.lower;
+        if (checkpoint && checkpoint->isFinished(ospcommon::math::box2i(
+            scene->windowOffset,
+            scene->windowOffset + buckets[i].size())))
         {
-            rhinoRenderWindow.SetProgress("Render finished.", 100);
+            pass += bucketPasses;
+            continue;
         }
-	}
+        _render->init(options, scene);
+
+        for (size_t j = 0; j < bucketPasses && !m_bCancel; ++j, ++pass)
+        {
+            ON_wString s = buckets.size() > 1 ?
+                ON_wString::FormatToString(L"Rendering bucket %d of %d, pass %d...", static_cast<int>(i + 1), static_cast<int>(buckets.size()), static_cast<int>(j + 1)) :
+                ON_wString::FormatToString(L"Rendering pass %d...", static_cast<int>(j + 1));
+            int percent = static_cast<int>(pass / static_cast<float>(totalPasses) * 100);
+            rhinoRenderWindow.SetProgress(s, percent);
+
+            // Render the pass, checking for cancellation while it renders so
+            // that StopRendering() does not have to wait for the whole pass.
+            if (!_render->render(j, rhinoRenderWindow, [&](float value)
+            {
+                const int p = static_cast<int>((pass + value) / static_cast<float>(totalPasses) * 100);
+                if (p != percent)
+                {
+                    percent = p;
+                    rhinoRenderWindow.SetProgress(s, percent);
+                }
+                return !m_bCancel;
+            }))
+                break;
+        }
+    }
+
+    _render->setImageCallback(nullptr);
+    if (!m_bCancel)
+    {
+        if (checkpoint)
+        {
+            checkpoint->remove();
+        }
+
+        rhinoRenderWindow.SetProgress("Render finished.", 100);
+
+        std::stringstream ss;
+        ss << "Render: " << buckets.size() << " buckets, " << totalPasses << " passes, " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - renderStart).count() << " ms";
+        Osprey::printMessage(ss.str());
+    }
 
 	SetContinueModal(false);
 }
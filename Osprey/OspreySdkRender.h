@@ -8,8 +8,8 @@
 
 namespace Osprey
 {
-    class ChangeQueue;
     class Render;
+    class ResidentScene;
     class Settings;
 
 } // namespace Osprey;
@@ -44,15 +44,18 @@ public:
 	virtual void StopRendering() override;
 	virtual void StartRendering() override;
 
+private:
+    void _updateSceneHash();
+
 private:
 	bool m_bContinueModal = true;
 	bool m_bRenderQuick = false;
-	bool m_bCancel = false;
+	std::atomic<bool> m_bCancel{ false };
 
     Osprey::Options _options;
-    std::shared_ptr<Osprey::Update> _update;
+    std::shared_ptr<Osprey::ResidentScene> _residentScene;
     std::shared_ptr<Osprey::Scene> _scene;
-    std::shared_ptr<Osprey::ChangeQueue> _changeQueue;
     std::shared_ptr<Osprey::Render> _render;
+    uint32_t _sceneHash = 0;
     std::thread _renderThread;
 };
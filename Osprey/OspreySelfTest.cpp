@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#include "stdafx.h"
+#include "OspreySelfTest.h"
+#include "OspreyFlatMap.h"
+#include "OspreyUtil.h"
+
+namespace Osprey
+{
+    namespace
+    {
+        // The number of random operations for each flat map check.
+        const size_t flatMapOps = 200000;
+
+        // The range of the random keys, small enough that keys are often
+        // erased and inserted again.
+        const ON__UINT32 flatMapKeys = 4096;
+
+        // The number of transforms to convert.
+        const size_t transformCount = 1000000;
+
+        //! This hash puts the keys in a few slots at the end of the table, so
+        //! the probe sequences are long and wrap around to the start.
+        struct WrapHash
+        {
+            size_t operator () (ON__UINT32 value) const
+            {
+                return ~static_cast<size_t>(value % 16);
+            }
+        };
+
+        template<typename H>
+        bool compare(const FlatMap<ON__UINT32, uint64_t, H>& map, const std::map<ON__UINT32, uint64_t>& ref)
+        {
+            if (map.size() != ref.size())
+                return false;
+            for (const auto& i : ref)
+            {
+                const auto j = map.find(i.first);
+                if (j == map.end() || j->second != i.second)
+                    return false;
+            }
+            size_t count = 0;
+            for (const auto& i : map)
+            {
+                const auto j = ref.find(i.first);
+                if (j == ref.end() || j->second != i.second)
+                    return false;
+                ++count;
+            }
+            return count == ref.size();
+        }
+
+        template<typename H>
+        bool testFlatMap(const char* name)
+        {
+            FlatMap<ON__UINT32, uint64_t, H> map;
+            std::map<ON__UINT32, uint64_t> ref;
+            std::mt19937 rng(1);
+            std::uniform_int_distribution<ON__UINT32> keys(0, flatMapKeys - 1);
+            std::uniform_int_distribution<int> ops(0, 9);
+            for (size_t i = 0; i < flatMapOps; ++i)
+            {
+                const ON__UINT32 key = keys(rng);
+                if (ops(rng) < 6)
+                {
+                    map[key] = i;
+                    ref[key] = i;
+                }
+                else if (map.erase(key) != (ref.erase(key) > 0))
+                {
+                    printError(std::string("Flat map (") + name + "): erase result differs");
+                    return false;
+                }
+
+                // Compare everything now and then, and on every operation
+                // while the table is small.
+                if ((ref.size() < 64 || 0 == i % 1024) && !compare(map, ref))
+                {
+                    std::stringstream ss;
+                    ss << "Flat map (" << name << "): contents differ after " << (i + 1) << " operations";
+                    printError(ss.str());
+                    return false;
+                }
+            }
+
+            // Remove everything through the iterators.
+            while (!map.empty())
+            {
+                const auto i = map.begin();
+                ref.erase(i->first);
+                map.erase(i);
+                if (!compare(map, ref))
+                {
+                    printError(std::string("Flat map (") + name + "): contents differ while clearing");
+                    return false;
+                }
+            }
+            return ref.empty();
+        }
+
+    } // namespace
+
+    bool testFlatMap()
+    {
+        const bool out =
+            testFlatMap<FlatHash<ON__UINT32> >("hash") &&
+            testFlatMap<WrapHash>("wrap");
+        if (out)
+        {
+            printMessage("Flat map: ok");
+        }
+        return out;
+    }
+
+    bool testTransforms()
+    {
+        // Every eighth transform has a projective row, which takes the
+        // scalar path of the batched conversion.
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> values(-1000.0, 1000.0);
+        std::vector<ON_Xform> xforms(transformCount);
+        std::vector<const ON_Xform*> xformPtrs(transformCount);
+        for (size_t i = 0; i < transformCount; ++i)
+        {
+            auto& xform = xforms[i];
+            for (int r = 0; r < 3; ++r)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    xform.m_xform[r][c] = values(rng);
+                }
+            }
+            const bool affine = i % 8 != 0;
+            xform.m_xform[3][0] = affine ? 0.0 : values(rng);
+            xform.m_xform[3][1] = affine ? 0.0 : values(rng);
+            xform.m_xform[3][2] = affine ? 0.0 : values(rng);
+            xform.m_xform[3][3] = 1.0;
+            xformPtrs[i] = &xform;
+        }
+
+        std::vector<ospcommon::math::affine3f> ref(transformCount);
+        auto t = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < transformCount; ++i)
+        {
+            ref[i] = fromRhino(xforms[i]);
+        }
+        const auto scalarTime = std::chrono::steady_clock::now() - t;
+
+        std::vector<ospcommon::math::affine3f> out(transformCount);
+        t = std::chrono::steady_clock::now();
+        fromRhino(xformPtrs.data(), transformCount, out.data());
+        const auto batchedTime = std::chrono::steady_clock::now() - t;
+
+        // The results must match bit for bit.
+        for (size_t i = 0; i < transformCount; ++i)
+        {
+            if (memcmp(&ref[i], &out[i], sizeof(ospcommon::math::affine3f)) != 0)
+            {
+                std::stringstream ss;
+                ss << "Transforms: transform " << i << " differs from the scalar conversion";
+                printError(ss.str());
+                return false;
+            }
+        }
+
+        std::stringstream ss;
+        ss << "Transforms: ok, " << transformCount << " transforms, scalar " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(scalarTime).count() << " ms, batched " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(batchedTime).count() << " ms";
+        printMessage(ss.str());
+        return true;
+    }
+
+} // namespace Osprey
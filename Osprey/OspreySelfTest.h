@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2020 Darby Johnston, All rights reserved
+
+#pragma once
+
+namespace Osprey
+{
+    //! Check the flat map against std::map with random insertions and
+    //! removals, including keys that collide and probe sequences that wrap
+    //! around the end of the table. Returns false if a check fails.
+    bool testFlatMap();
+
+    //! Check the batched transform conversion against the scalar conversion,
+    //! and print the time of both. Returns false if a check fails.
+    bool testTransforms();
+
+} // namespace Osprey
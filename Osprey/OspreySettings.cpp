@@ -17,6 +17,20 @@ namespace Osprey
         _denoiserEnabled = ValueSubject<bool>::create(true);
         _toneMapperEnabled = ValueSubject<bool>::create(true);
         _toneMapperExposure = ValueSubject<Exposure>::create(Exposure::_2_0);
+        _flattenMeshes = ValueSubject<bool>::create(false);
+        _bvhPolicy = ValueSubject<BVHPolicy>::create(BVHPolicy::Automatic);
+        _bucketSize = ValueSubject<BucketSize>::create(BucketSize::Automatic);
+        _checkpoints = ValueSubject<bool>::create(false);
+        _device = ValueSubject<Device>::create(Device::Local);
+        _threadCount = ValueSubject<ThreadCount>::create(ThreadCount::Automatic);
+        _reservedCores = ValueSubject<ReservedCores>::create(ReservedCores::_0);
+        _threadAffinity = ValueSubject<bool>::create(false);
+        _logLevel = ValueSubject<LogLevel>::create(LogLevel::Info);
+        _logFile = ValueSubject<bool>::create(false);
+        _denoiserInterval = ValueSubject<DenoiserInterval>::create(DenoiserInterval::EveryPass);
+        _denoisePreviews = ValueSubject<bool>::create(false);
+        _pointBudget = ValueSubject<PointBudget>::create(PointBudget::_5M);
+        _options = ValueSubject<Options>::create(getOptions());
     }
 
 	std::shared_ptr<Settings> Settings::create()
@@ -69,49 +83,270 @@ namespace Osprey
         return _toneMapperExposure;
     }
 
+    std::shared_ptr<IValueSubject<bool> > Settings::observeFlattenMeshes() const
+    {
+        return _flattenMeshes;
+    }
+
+    std::shared_ptr<IValueSubject<BVHPolicy> > Settings::observeBVHPolicy() const
+    {
+        return _bvhPolicy;
+    }
+
+    std::shared_ptr<IValueSubject<BucketSize> > Settings::observeBucketSize() const
+    {
+        return _bucketSize;
+    }
+
+    std::shared_ptr<IValueSubject<bool> > Settings::observeCheckpoints() const
+    {
+        return _checkpoints;
+    }
+
+    std::shared_ptr<IValueSubject<Device> > Settings::observeDevice() const
+    {
+        return _device;
+    }
+
+    std::shared_ptr<IValueSubject<ThreadCount> > Settings::observeThreadCount() const
+    {
+        return _threadCount;
+    }
+
+    std::shared_ptr<IValueSubject<ReservedCores> > Settings::observeReservedCores() const
+    {
+        return _reservedCores;
+    }
+
+    std::shared_ptr<IValueSubject<bool> > Settings::observeThreadAffinity() const
+    {
+        return _threadAffinity;
+    }
+
+    std::shared_ptr<IValueSubject<LogLevel> > Settings::observeLogLevel() const
+    {
+        return _logLevel;
+    }
+
+    std::shared_ptr<IValueSubject<bool> > Settings::observeLogFile() const
+    {
+        return _logFile;
+    }
+
+    std::shared_ptr<IValueSubject<DenoiserInterval> > Settings::observeDenoiserInterval() const
+    {
+        return _denoiserInterval;
+    }
+
+    std::shared_ptr<IValueSubject<bool> > Settings::observeDenoisePreviews() const
+    {
+        return _denoisePreviews;
+    }
+
+    std::shared_ptr<IValueSubject<PointBudget> > Settings::observePointBudget() const
+    {
+        return _pointBudget;
+    }
+
 	void Settings::setRenderer(Renderer value)
 	{
-		_renderer->setIfChanged(value);
+		if (_renderer->setIfChanged(value))
+		{
+			_optionsChanged();
+		}
 	}
 
     void Settings::setPasses(Passes value)
     {
-        _passes->setIfChanged(value);
+        if (_passes->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
     }
 
     void Settings::setPreviewPasses(PreviewPasses value)
     {
-        _previewPasses->setIfChanged(value);
+        if (_previewPasses->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
     }
 
     void Settings::setPixelSamples(PixelSamples value)
 	{
-		_pixelSamples->setIfChanged(value);
+		if (_pixelSamples->setIfChanged(value))
+		{
+			_optionsChanged();
+		}
 	}
 
 	void Settings::setAOSamples(AOSamples value)
 	{
-		_aoSamples->setIfChanged(value);
+		if (_aoSamples->setIfChanged(value))
+		{
+			_optionsChanged();
+		}
 	}
 
     void Settings::setDenoiserFound(bool value)
     {
-        _denoiserFound->setIfChanged(value);
+        if (_denoiserFound->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
     }
 
     void Settings::setDenoiserEnabled(bool value)
     {
-        _denoiserEnabled->setIfChanged(value);
+        if (_denoiserEnabled->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
     }
 
     void Settings::setToneMapperEnabled(bool value)
     {
-        _toneMapperEnabled->setIfChanged(value);
+        if (_toneMapperEnabled->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
     }
 
     void Settings::setToneMapperExposure(Exposure value)
     {
-        _toneMapperExposure->setIfChanged(value);
+        if (_toneMapperExposure->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
+    }
+
+    void Settings::setFlattenMeshes(bool value)
+    {
+        if (_flattenMeshes->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
+    }
+
+    void Settings::setBVHPolicy(BVHPolicy value)
+    {
+        if (_bvhPolicy->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
+    }
+
+    void Settings::setBucketSize(BucketSize value)
+    {
+        if (_bucketSize->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
+    }
+
+    void Settings::setCheckpoints(bool value)
+    {
+        if (_checkpoints->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
+    }
+
+    void Settings::setDevice(Device value)
+    {
+        _device->setIfChanged(value);
+    }
+
+    void Settings::setThreadCount(ThreadCount value)
+    {
+        _threadCount->setIfChanged(value);
+    }
+
+    void Settings::setReservedCores(ReservedCores value)
+    {
+        _reservedCores->setIfChanged(value);
+    }
+
+    void Settings::setThreadAffinity(bool value)
+    {
+        _threadAffinity->setIfChanged(value);
+    }
+
+    void Settings::setLogLevel(LogLevel value)
+    {
+        _logLevel->setIfChanged(value);
+    }
+
+    void Settings::setLogFile(bool value)
+    {
+        _logFile->setIfChanged(value);
+    }
+
+    void Settings::setDenoiserInterval(DenoiserInterval value)
+    {
+        if (_denoiserInterval->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
+    }
+
+    void Settings::setDenoisePreviews(bool value)
+    {
+        if (_denoisePreviews->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
+    }
+
+    void Settings::setPointBudget(PointBudget value)
+    {
+        if (_pointBudget->setIfChanged(value))
+        {
+            _optionsChanged();
+        }
+    }
+
+    std::shared_ptr<IValueSubject<Options> > Settings::observeOptions() const
+    {
+        return _options;
+    }
+
+    Options Settings::getOptions() const
+    {
+        Options out;
+        out.rendererName = getRendererValue(_renderer->get());
+        out.supportsMaterials = getRendererSupportsMaterials(_renderer->get());
+        out.passes = getPassesValue(_passes->get());
+        out.previewPasses = getPreviewPassesValue(_previewPasses->get());
+        out.pixelSamples = getPixelSamplesValue(_pixelSamples->get());
+        out.aoSamples = getAOSamplesValue(_aoSamples->get());
+        out.denoiserFound = _denoiserFound->get();
+        out.denoiserEnabled = _denoiserEnabled->get();
+        out.denoiserInterval = _denoiserInterval->get();
+        out.denoisePreviews = _denoisePreviews->get();
+        out.toneMapperEnabled = _toneMapperEnabled->get();
+        out.toneMapperExposure = getExposureValue(_toneMapperExposure->get());
+        out.flattenMeshes = _flattenMeshes->get();
+        out.bvhPolicy = _bvhPolicy->get();
+        out.bucketSize = _bucketSize->get();
+        out.checkpoints = _checkpoints->get();
+        out.pointBudget = _pointBudget->get();
+        return out;
+    }
+
+    DeviceOptions Settings::getDeviceOptions() const
+    {
+        DeviceOptions out;
+        out.device = _device->get();
+        out.threadCount = _threadCount->get();
+        out.reservedCores = _reservedCores->get();
+        out.threadAffinity = _threadAffinity->get();
+        return out;
+    }
+
+    void Settings::_optionsChanged()
+    {
+        _options->setIfChanged(getOptions());
     }
 
 } // namespace Osprey
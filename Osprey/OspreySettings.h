@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "OspreyData.h"
 #include "OspreyEnum.h"
 #include "OspreyValueObserver.h"
 
@@ -27,6 +28,19 @@ namespace Osprey
         std::shared_ptr<IValueSubject<bool> > observeDenoiserEnabled() const;
         std::shared_ptr<IValueSubject<bool> > observeToneMapperEnabled() const;
         std::shared_ptr<IValueSubject<Exposure> > observeToneMapperExposure() const;
+        std::shared_ptr<IValueSubject<bool> > observeFlattenMeshes() const;
+        std::shared_ptr<IValueSubject<BVHPolicy> > observeBVHPolicy() const;
+        std::shared_ptr<IValueSubject<BucketSize> > observeBucketSize() const;
+        std::shared_ptr<IValueSubject<bool> > observeCheckpoints() const;
+        std::shared_ptr<IValueSubject<Device> > observeDevice() const;
+        std::shared_ptr<IValueSubject<ThreadCount> > observeThreadCount() const;
+        std::shared_ptr<IValueSubject<ReservedCores> > observeReservedCores() const;
+        std::shared_ptr<IValueSubject<bool> > observeThreadAffinity() const;
+        std::shared_ptr<IValueSubject<LogLevel> > observeLogLevel() const;
+        std::shared_ptr<IValueSubject<bool> > observeLogFile() const;
+        std::shared_ptr<IValueSubject<DenoiserInterval> > observeDenoiserInterval() const;
+        std::shared_ptr<IValueSubject<bool> > observeDenoisePreviews() const;
+        std::shared_ptr<IValueSubject<PointBudget> > observePointBudget() const;
 
 		void setRenderer(Renderer);
         void setPasses(Passes);
@@ -37,8 +51,33 @@ namespace Osprey
         void setDenoiserEnabled(bool);
         void setToneMapperEnabled(bool);
         void setToneMapperExposure(Exposure);
+        void setFlattenMeshes(bool);
+        void setBVHPolicy(BVHPolicy);
+        void setBucketSize(BucketSize);
+        void setCheckpoints(bool);
+        void setDevice(Device);
+        void setThreadCount(ThreadCount);
+        void setReservedCores(ReservedCores);
+        void setThreadAffinity(bool);
+        void setLogLevel(LogLevel);
+        void setLogFile(bool);
+        void setDenoiserInterval(DenoiserInterval);
+        void setDenoisePreviews(bool);
+        void setPointBudget(PointBudget);
+
+        //! Observe the rendering options. The observers are only called
+        //! when a setting that affects rendering changes.
+        std::shared_ptr<IValueSubject<Options> > observeOptions() const;
+
+        //! Get the rendering options for the current settings.
+        Options getOptions() const;
+
+        //! Get the device options for the current settings.
+        DeviceOptions getDeviceOptions() const;
 
 	private:
+        void _optionsChanged();
+
 		std::shared_ptr<ValueSubject<Renderer> > _renderer;
         std::shared_ptr<ValueSubject<Passes> > _passes;
         std::shared_ptr<ValueSubject<PreviewPasses> > _previewPasses;
@@ -48,6 +87,20 @@ namespace Osprey
         std::shared_ptr<ValueSubject<bool> > _denoiserEnabled;
         std::shared_ptr<ValueSubject<bool> > _toneMapperEnabled;
         std::shared_ptr<ValueSubject<Exposure> > _toneMapperExposure;
+        std::shared_ptr<ValueSubject<bool> > _flattenMeshes;
+        std::shared_ptr<ValueSubject<BVHPolicy> > _bvhPolicy;
+        std::shared_ptr<ValueSubject<BucketSize> > _bucketSize;
+        std::shared_ptr<ValueSubject<bool> > _checkpoints;
+        std::shared_ptr<ValueSubject<Device> > _device;
+        std::shared_ptr<ValueSubject<ThreadCount> > _threadCount;
+        std::shared_ptr<ValueSubject<ReservedCores> > _reservedCores;
+        std::shared_ptr<ValueSubject<bool> > _threadAffinity;
+        std::shared_ptr<ValueSubject<LogLevel> > _logLevel;
+        std::shared_ptr<ValueSubject<bool> > _logFile;
+        std::shared_ptr<ValueSubject<DenoiserInterval> > _denoiserInterval;
+        std::shared_ptr<ValueSubject<bool> > _denoisePreviews;
+        std::shared_ptr<ValueSubject<PointBudget> > _pointBudget;
+        std::shared_ptr<ValueSubject<Options> > _options;
 	};
 
 } // namespace Osprey
@@ -2,6 +2,7 @@
 // Copyright (c) 2020 Darby Johnston, All rights reserved
 
 #include "stdafx.h"
+#include "OspreyLog.h"
 #include "OspreyUtil.h"
 
 namespace Osprey
@@ -23,12 +24,17 @@ namespace Osprey
 
 	void printError(const std::string& value)
 	{
-		RhinoApp().Print("Osprey ERROR: %s\n", value.c_str());
+		log(LogLevel::Error, value.c_str());
 	}
 
 	void printMessage(const std::string& value)
 	{
-		RhinoApp().Print("Osprey: %s\n", value.c_str());
+		log(LogLevel::Info, value.c_str());
+	}
+
+	void printDebug(const std::string& value)
+	{
+		log(LogLevel::Debug, value.c_str());
 	}
 
 	void errorFunc(OSPError ospError, const char* buf)
@@ -40,7 +46,9 @@ namespace Osprey
 
 	void messageFunc(const char* buf)
 	{
-		printMessage(buf);
+		// The status messages are already filtered by the log level of the
+		// device.
+		log(getLogLevel(), buf);
 	}
 
 	ospcommon::math::vec2i fromRhino(const ON_2iSize& value)
@@ -108,6 +116,65 @@ namespace Osprey
 			fromRhino(translation));
 	}
 
+	namespace
+	{
+		static_assert(
+			sizeof(ospcommon::math::affine3f) == 12 * sizeof(float),
+			"The affine transform must be tightly packed");
+
+		bool isAffine(const ON_Xform& value)
+		{
+			return
+				0.0 == value.m_xform[3][0] &&
+				0.0 == value.m_xform[3][1] &&
+				0.0 == value.m_xform[3][2] &&
+				1.0 == value.m_xform[3][3];
+		}
+
+		void convertAffine(const ON_Xform& value, ospcommon::math::affine3f& out)
+		{
+			// Convert the first three rows to single precision and transpose
+			// them into the columns of the affine transform.
+			const double* m = &value.m_xform[0][0];
+			__m128 r0 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(m)), _mm_cvtpd_ps(_mm_loadu_pd(m + 2)));
+			__m128 r1 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(m + 4)), _mm_cvtpd_ps(_mm_loadu_pd(m + 6)));
+			__m128 r2 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(m + 8)), _mm_cvtpd_ps(_mm_loadu_pd(m + 10)));
+			__m128 r3 = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			// Each store writes one float past the column, which is then
+			// overwritten by the next column.
+			float* outP = &out.l.vx.x;
+			_mm_storeu_ps(outP, r0);
+			_mm_storeu_ps(outP + 3, r1);
+			_mm_storeu_ps(outP + 6, r2);
+			float p[4];
+			_mm_storeu_ps(p, r3);
+			memcpy(outP + 9, p, 3 * sizeof(float));
+		}
+
+	} // namespace
+
+	void fromRhino(const ON_Xform* const* in, size_t count, ospcommon::math::affine3f* out)
+	{
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>(0, count, 1024),
+			[in, out](const tbb::blocked_range<size_t>& r)
+		{
+			for (size_t i = r.begin(); i != r.end(); ++i)
+			{
+				if (isAffine(*in[i]))
+				{
+					convertAffine(*in[i], out[i]);
+				}
+				else
+				{
+					out[i] = fromRhino(*in[i]);
+				}
+			}
+		});
+	}
+
 	ON_2iSize toRhino(const ospcommon::math::vec2i& value)
 	{
 		return ON_2iSize(value.x, value.y);
@@ -10,6 +10,7 @@ namespace Osprey
 	std::string getErrorMessage(OSPError);
 	void printError(const std::string&);
 	void printMessage(const std::string&);
+	void printDebug(const std::string&);
 
 	void errorFunc(OSPError, const char*);
 	void messageFunc(const char*);
@@ -25,6 +26,10 @@ namespace Osprey
 
 	ospcommon::math::affine3f fromRhino(const ON_Xform&);
 
+	//! Convert an array of transforms in parallel. Transforms that are already
+	//! affine are converted with SIMD instead of being decomposed.
+	void fromRhino(const ON_Xform* const*, size_t count, ospcommon::math::affine3f*);
+
 	ON_2iSize toRhino(const ospcommon::math::vec2i&);
 
 } // namespace Osprey
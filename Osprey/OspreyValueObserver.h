@@ -37,15 +37,16 @@ namespace Osprey
         std::weak_ptr<IValueSubject<T> > _subject;
     };
 
-    //! This class provides an interface for a value subject.
+    //! This class provides an interface for a value subject. Observers can be
+    //! added and removed from any thread.
     template<typename T>
     class IValueSubject
     {
     public:
         virtual ~IValueSubject() = 0;
 
-        //! Get the value.
-        virtual const T& get() const = 0;
+        //! Get a copy of the value.
+        virtual T get() const = 0;
 
         //! Get the number of observers.
         size_t getObserversCount() const;
@@ -54,6 +55,11 @@ namespace Osprey
         void _add(const std::weak_ptr<ValueObserver<T> >&);
         void _remove(ValueObserver<T>*);
 
+        //! Get a copy of the observers, so that the callbacks are not called
+        //! while holding the lock.
+        std::vector<std::shared_ptr<ValueObserver<T> > > _getObservers() const;
+
+        mutable std::mutex _mutex;
         std::vector<std::weak_ptr<ValueObserver<T> > > _observers;
 
         friend class ValueObserver<T>;
@@ -82,7 +88,7 @@ namespace Osprey
         //! Set the value only if it has changed.
         bool setIfChanged(const T&);
 
-        const T& get() const override;
+        T get() const override;
 
     private:
         T _value = T();
@@ -126,18 +132,21 @@ namespace Osprey
     template<typename T>
     inline size_t IValueSubject<T>::getObserversCount() const
     {
+        std::lock_guard<std::mutex> lock(_mutex);
         return _observers.size();
     }
 
     template<typename T>
     inline void IValueSubject<T>::_add(const std::weak_ptr<ValueObserver<T> >& observer)
     {
+        std::lock_guard<std::mutex> lock(_mutex);
         _observers.push_back(observer);
     }
 
     template<typename T>
     inline void IValueSubject<T>::_remove(ValueObserver<T>* observer)
     {
+        std::lock_guard<std::mutex> lock(_mutex);
         auto i = _observers.begin();
         while (i != _observers.end())
         {
@@ -164,6 +173,22 @@ namespace Osprey
         }
     }
 
+    template<typename T>
+    inline std::vector<std::shared_ptr<ValueObserver<T> > > IValueSubject<T>::_getObservers() const
+    {
+        std::vector<std::shared_ptr<ValueObserver<T> > > out;
+        std::lock_guard<std::mutex> lock(_mutex);
+        out.reserve(_observers.size());
+        for (const auto& i : _observers)
+        {
+            if (auto observer = i.lock())
+            {
+                out.push_back(observer);
+            }
+        }
+        return out;
+    }
+
     template<typename T>
     inline std::shared_ptr<ValueObserver<T> > ValueObserver<T>::create(const std::weak_ptr<IValueSubject<T> >& value, const std::function<void(const T&)>& callback)
     {
@@ -196,35 +221,36 @@ namespace Osprey
     template<typename T>
     inline void ValueSubject<T>::setAlways(const T& value)
     {
-        _value = value;
-        for (const auto& s : IValueSubject<T>::_observers)
         {
-            if (auto observer = s.lock())
-            {
-                observer->doCallback(_value);
-            }
+            std::lock_guard<std::mutex> lock(IValueSubject<T>::_mutex);
+            _value = value;
+        }
+        for (const auto& observer : IValueSubject<T>::_getObservers())
+        {
+            observer->doCallback(value);
         }
     }
 
     template<typename T>
     inline bool ValueSubject<T>::setIfChanged(const T& value)
     {
-        if (value == _value)
-            return false;
-        _value = value;
-        for (const auto& s : IValueSubject<T>::_observers)
         {
-            if (auto observer = s.lock())
-            {
-                observer->doCallback(_value);
-            }
+            std::lock_guard<std::mutex> lock(IValueSubject<T>::_mutex);
+            if (value == _value)
+                return false;
+            _value = value;
+        }
+        for (const auto& observer : IValueSubject<T>::_getObservers())
+        {
+            observer->doCallback(value);
         }
         return true;
     }
 
     template<typename T>
-    inline const T& ValueSubject<T>::get() const
+    inline T ValueSubject<T>::get() const
     {
+        std::lock_guard<std::mutex> lock(IValueSubject<T>::_mutex);
         return _value;
     }
 
@@ -23,6 +23,27 @@
 #define IDD_OPTIONS_TONE_MAPPER_CHECKBOX 212
 #define IDD_OPTIONS_TONE_MAPPER_EXPOSURE_LABEL 213
 #define IDD_OPTIONS_TONE_MAPPER_EXPOSURE_COMBOBOX 214
+#define IDD_OPTIONS_FLATTEN_MESHES_CHECKBOX 215
+#define IDD_OPTIONS_BVH_POLICY_LABEL    216
+#define IDD_OPTIONS_BVH_POLICY_COMBOBOX 217
+#define IDD_OPTIONS_BUCKET_SIZE_LABEL   218
+#define IDD_OPTIONS_BUCKET_SIZE_COMBOBOX 219
+#define IDD_OPTIONS_CHECKPOINTS_CHECKBOX 220
+#define IDD_OPTIONS_DEVICE_LABEL        221
+#define IDD_OPTIONS_DEVICE_COMBOBOX     222
+#define IDD_OPTIONS_THREAD_COUNT_LABEL  223
+#define IDD_OPTIONS_THREAD_COUNT_COMBOBOX 224
+#define IDD_OPTIONS_RESERVED_CORES_LABEL 225
+#define IDD_OPTIONS_RESERVED_CORES_COMBOBOX 226
+#define IDD_OPTIONS_THREAD_AFFINITY_CHECKBOX 227
+#define IDD_OPTIONS_LOG_LEVEL_LABEL     228
+#define IDD_OPTIONS_LOG_LEVEL_COMBOBOX  229
+#define IDD_OPTIONS_LOG_FILE_CHECKBOX   230
+#define IDD_OPTIONS_DENOISER_INTERVAL_LABEL 231
+#define IDD_OPTIONS_DENOISER_INTERVAL_COMBOBOX 232
+#define IDD_OPTIONS_DENOISE_PREVIEWS_CHECKBOX 233
+#define IDD_OPTIONS_POINT_BUDGET_LABEL  234
+#define IDD_OPTIONS_POINT_BUDGET_COMBOBOX 235
 #define IDI_RENDER                      1001
 #define IDR_RENDER                      12006
 #define ID_APP_VIEW_NORMALVIEW          32777
@@ -84,13 +84,19 @@
 #include "tbb/tbb.h"
 
 // Osprey
+#include <emmintrin.h>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <future>
 #include <list>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <string>
+#include <thread>
 #include <vector>
 
 #if defined(RHINO_DEBUG_PLUGIN)